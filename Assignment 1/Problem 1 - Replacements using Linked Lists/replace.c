@@ -2,14 +2,36 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <ctype.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h> // for the parallel mode (compile with -pthread)
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+#include "../tokenizer.h"
 
 #define MAX_LEN 10000
 
+// Size of a cache line in bytes. A chunk is sized to fill exactly CHUNK_CACHE_LINES cache lines,
+// e.g. compile with -DCHUNK_CACHE_LINES=2 for 128 byte chunks (or set -DCHUNK_CAPACITY directly)
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+#ifndef CHUNK_CACHE_LINES
+#define CHUNK_CACHE_LINES 1
+#endif
+// Number of integers in a chunk: whatever fits in the cache line(s) after the 'next' pointer and the 'count' field (13 for 64 byte lines)
+#ifndef CHUNK_CAPACITY
+#define CHUNK_CAPACITY ((int) ((CACHE_LINE_SIZE * CHUNK_CACHE_LINES - sizeof(void *) - sizeof(int)) / sizeof(int)))
+#endif
+
 // Used to store sequence using 'chunk' lists
 typedef struct Chunk
 {
-    int arr[8];
     struct Chunk *next;
+    int count; // number of integers stored in arr[0..count-1] (every chunk in a list holds atleast one integer)
+    int arr[CHUNK_CAPACITY];
 } Chunk;
 
 // Used to store pattern and text using normal lists 
@@ -19,23 +41,223 @@ typedef struct Node
     struct Node *next;
 } Node;
 
-// Create a new node of the type Chunk
+// Pattern preprocessed for KMP (Knuth-Morris-Pratt) matching
+typedef struct Matcher
+{
+    int length; // number of integers in the pattern
+    int *pattern; // pattern copied into an array, for O(1) access to pattern[q]
+    int *failure; // failure[q] = length of the longest proper prefix of pattern[0..q] which is also a suffix of pattern[0..q]
+} Matcher;
+
+// Used to append integers one-by-one at the end of a chunk list which is being built
+typedef struct ChunkWriter
+{
+    Chunk *head;
+    Chunk *tail;
+    FILE *stream; // If not NULL, every chunk is printed to this stream as soon as it is full and then reused, instead of building a list
+} ChunkWriter;
+
+// Position of an integer in a chunk list, along with the chunk before it (needed to unlink the chunk during in-place replacement)
+typedef struct Position
+{
+    Chunk *node;
+    Chunk *prev;
+    int index;
+} Position;
+
+// Size of the blocks in which the streaming mode reads its input
+#define BLOCK_SIZE 65536
+
+// One rewrite rule (pattern -> text) of the multi-pattern mode
+typedef struct Rule
+{
+    Node *pattern;
+    Node *text;
+    int length; // number of integers in the pattern
+} Rule;
+
+// State of an Aho-Corasick automaton (a node of the trie of all the patterns)
+typedef struct ACState
+{
+    int value; // integer on the trie edge entering this state
+    int depth; // length of the pattern prefix represented by this state
+    int first_child, next_sibling; // children of this state in the trie (-1 if none), used while building the failure links
+    int fail; // state of the longest proper suffix of this prefix which is also a prefix of some pattern
+    int output; // rule whose pattern ends at this state (-1 if none)
+    int dict; // nearest state on the failure chain (excluding this state) whose output is not -1 (-1 if none)
+} ACState;
+
+// Aho-Corasick automaton over an integer alphabet, built from many rewrite rules
+// The goto transitions are stored in an open addressing hash table keyed by (state, value), since the alphabet is all of 'int'
+typedef struct Automaton
+{
+    ACState *states;
+    int num_states;
+    int capacity;
+    long long *edge_keys; // (state << 32 | value) of every transition, -1 for an empty slot
+    int *edge_targets;
+    int edge_capacity; // always a power of 2
+    int num_edges;
+    Rule *rules;
+    int num_rules;
+    int max_length; // length of the longest pattern
+} Automaton;
+
+// Number of objects carved out of every slab of a pool
+#define SLAB_OBJECTS 4096
+
+// Pool (slab) allocator for objects of one fixed size, used for the nodes of both kinds of lists.
+// Objects are cut from large slabs, and freed objects are kept in a free list (linked through their first bytes) to be reused,
+// so allocating or freeing a node is a few pointer operations instead of a malloc/free round-trip.
+// Slabs are only returned to the system by 'pool_destroy'.
+typedef struct Pool
+{
+    size_t object_size; // size of every object (a multiple of 'alignment')
+    size_t alignment;
+    void *free_list; // freed objects, available for reuse
+    char *bump; // next unused object of the newest slab
+    int bump_left; // number of unused objects left in the newest slab
+    char **slabs;
+    int num_slabs, slab_capacity;
+    // statistics
+    long long allocations; // objects handed out
+    long long reused; // objects handed out from the free list
+    long long frees; // objects given back
+} Pool;
+
+// Pools of chunks (cache line aligned) and of normal nodes
+Pool chunk_pool = {(sizeof(Chunk) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE, CACHE_LINE_SIZE, NULL, NULL, 0, NULL, 0, 0, 0, 0, 0};
+Pool node_pool = {sizeof(Node), sizeof(void *), NULL, NULL, 0, NULL, 0, 0, 0, 0, 0};
+// Pools used to create and free nodes in the current thread (worker threads use private pools, as pools aren't thread-safe)
+_Thread_local Pool *thread_chunk_pool = &chunk_pool;
+_Thread_local Pool *thread_node_pool = &node_pool;
+
+// Function to take one object from a pool (reusing a freed one if possible, otherwise cutting it from a slab)
+void* pool_alloc(Pool *pool)
+{
+    pool -> allocations += 1;
+    if (pool -> free_list != NULL)
+    {
+        void *object = pool -> free_list;
+        pool -> free_list = *(void **) object;
+        pool -> reused += 1;
+        return object;
+    }
+    if (pool -> bump_left == 0)
+    {
+        // Newest slab is used up, so allocate a new one
+        if (pool -> num_slabs == pool -> slab_capacity)
+        {
+            pool -> slab_capacity = (pool -> slab_capacity > 0) ? 2 * pool -> slab_capacity : 16;
+            pool -> slabs = (char **) realloc(pool -> slabs, pool -> slab_capacity * sizeof(char *));
+        }
+        pool -> bump = (char *) aligned_alloc(pool -> alignment, SLAB_OBJECTS * pool -> object_size);
+        pool -> slabs[pool -> num_slabs++] = pool -> bump;
+        pool -> bump_left = SLAB_OBJECTS;
+    }
+    void *object = pool -> bump;
+    pool -> bump += pool -> object_size;
+    pool -> bump_left -= 1;
+    return object;
+}
+
+// Function to give an object back to its pool
+void pool_free(Pool *pool, void *object)
+{
+    *(void **) object = pool -> free_list;
+    pool -> free_list = object;
+    pool -> frees += 1;
+}
+
+// Function to move upto 'count' freed objects of pool 'from' to the free list of pool 'into' (both pools must have the same object size)
+void pool_lend(Pool *into, Pool *from, int count)
+{
+    while (count > 0 && from -> free_list != NULL)
+    {
+        void *object = from -> free_list;
+        from -> free_list = *(void **) object;
+        *(void **) object = into -> free_list;
+        into -> free_list = object;
+        count--;
+    }
+}
+
+// Function to move all the objects (and slabs) of pool 'from' into pool 'into', so that they can be freed into 'into' later
+void pool_absorb(Pool *into, Pool *from)
+{
+    for (int k = 0; k < from -> num_slabs; k++)
+    {
+        if (into -> num_slabs == into -> slab_capacity)
+        {
+            into -> slab_capacity = (into -> slab_capacity > 0) ? 2 * into -> slab_capacity : 16;
+            into -> slabs = (char **) realloc(into -> slabs, into -> slab_capacity * sizeof(char *));
+        }
+        into -> slabs[into -> num_slabs++] = from -> slabs[k];
+    }
+    // Append the free list of 'into' after the free list of 'from' (the unused objects of the newest slab of 'from' are dropped)
+    if (from -> free_list != NULL)
+    {
+        void *last = from -> free_list;
+        while (*(void **) last != NULL)
+        {
+            last = *(void **) last;
+        }
+        *(void **) last = into -> free_list;
+        into -> free_list = from -> free_list;
+    }
+    into -> allocations += from -> allocations;
+    into -> reused += from -> reused;
+    into -> frees += from -> frees;
+
+    free(from -> slabs);
+    from -> slabs = NULL;
+    from -> num_slabs = from -> slab_capacity = 0;
+    from -> free_list = NULL;
+    from -> bump = NULL;
+    from -> bump_left = 0;
+}
+
+// Function to free all the slabs of a pool at once (every object of the pool becomes invalid); the statistics are kept
+void pool_destroy(Pool *pool)
+{
+    for (int k = 0; k < pool -> num_slabs; k++)
+    {
+        free(pool -> slabs[k]);
+    }
+    free(pool -> slabs);
+    pool -> slabs = NULL;
+    pool -> num_slabs = pool -> slab_capacity = 0;
+    pool -> free_list = NULL;
+    pool -> bump = NULL;
+    pool -> bump_left = 0;
+}
+
+// Statistics hook: print how many objects each pool handed out, and how many malloc calls that saved
+void print_pool_stats(FILE *stream)
+{
+    Pool *pools[2] = {&chunk_pool, &node_pool};
+    char *names[2] = {"Chunk", "Node"};
+    for (int k = 0; k < 2; k++)
+    {
+        Pool *pool = pools[k];
+        fprintf(stream, "%s pool: %lld allocations (%lld reused), %lld frees, %d slabs of %d, %lld allocator calls avoided\n",
+            names[k], pool -> allocations, pool -> reused, pool -> frees, pool -> num_slabs, SLAB_OBJECTS, pool -> allocations - pool -> num_slabs);
+    }
+}
+
+// Create a new (empty) node of the type Chunk, aligned to a cache line
 Chunk* create_chunk_node()
 {
-    Chunk *node = (Chunk*) malloc(sizeof(Chunk));
+    Chunk *node = (Chunk*) pool_alloc(thread_chunk_pool);
     node -> next = NULL;
-    // Initialise all array elements to INT_MIN (to represent minus-infinity)
-    for (int i = 0; i < 8; i++)
-    {
-        node->arr[i] = INT_MIN;
-    } 
+    node -> count = 0;
     return node;
 }
 
 // Create a new node for normal linked lists
 Node* create_node()
 {
-    Node *node = (Node*) malloc(sizeof(Node));
+    Node *node = (Node*) pool_alloc(thread_node_pool);
     node -> next = NULL;
     node -> val = INT_MIN;
     return node;
@@ -47,12 +269,8 @@ void traverse_chunk_LL(Chunk *node)
     while (node != NULL)
     {
         printf("-->(%d", node->arr[0]); // Valid because each chunk contains atleast one integer, otherwise it wouldn't exist
-        for (int i = 1; i < 8; i++)
+        for (int i = 1; i < node->count; i++)
         {
-            if (node->arr[i] == INT_MIN)
-            {
-                break;
-            }
             printf(",%d", node->arr[i]);
         }
         printf(")");
@@ -61,6 +279,18 @@ void traverse_chunk_LL(Chunk *node)
     printf("\n");
 }
 
+// Function to move (node, index) to the next integer of a chunk list
+// (chunks in the middle of a list can be partially filled after in-place replacements, so 'count' is checked instead of CHUNK_CAPACITY)
+void next_position(Chunk **node, int *index)
+{
+    *index += 1;
+    if (*index == (*node) -> count)
+    {
+        *node = (*node) -> next;
+        *index = 0;
+    }
+}
+
 // function to traverse and print normal linked lists
 void traverse_LL(Node *node)
 {
@@ -80,7 +310,7 @@ void free_chunk_LL(Chunk *node)
     {
         prev = node;
         node = node -> next;
-        free(prev);
+        pool_free(thread_chunk_pool, prev);
     }
 }
 
@@ -92,65 +322,104 @@ void free_LL(Node *node)
     {
         prev = node;
         node = node -> next;
-        free(prev);
+        pool_free(thread_node_pool, prev);
     }
 }
 
-// Function which takes 'sequence' as input from the user
-// and stores it in a chunk list and returns the base address of that list
-Chunk* input_sequence()
-{
-    char *str = (char *) calloc(MAX_LEN, sizeof(char));
-    scanf("%s", str);
-
-    Chunk *head, *node;
-    head = node = NULL;
+void writer_append(ChunkWriter *writer, int val);
 
-    // Extract integers one-by-one from the string 'str' and insert them into chunks
-    int i = 0, index = 0; // 'index' represents the chunk index where integer has to be inserted
-    while (str[i] != '$')
+// Function to parse a '$' terminated list of comma separated integers (e.g. "1,2,3,$"), and append the integers to 'writer'
+// Returns 0 if the list is malformed (the error is recorded in 'tok')
+int parse_sequence(Tokenizer *tok, ChunkWriter *writer)
+{
+    while (tokenizer_peek(tok) != '$')
     {
-        int j = 0;
-        char num[50] = "";
-        while (str[i] != ',')
+        int val;
+        if (tokenizer_peek(tok) == -1)
         {
-            num[j] = str[i];
-            j++;
-            i++;
+            return tokenizer_fail(tok, "missing '$' at the end of the list");
         }
-        num[j] = 0; // Append NULL at the end of the string
-        i++; // skip the ',' character
-
-        if (index == 0)
+        if (!tokenizer_int(tok, &val) || !tokenizer_expect(tok, ','))
         {
-            // previous chunk is full, so create a new chunk
-            Chunk *new_node = create_chunk_node();
-            new_node->arr[index] = atoi(num);
+            return 0;
+        }
+        writer_append(writer, val);
+    }
+    tok -> pos++; // skip the '$' character
+    return 1;
+}
 
-            // Now append this node at the end of the current LL
-            if (head == NULL)
-            {
-                head = node = new_node;
-            }
-            else 
-            {
-                node -> next = new_node;
-                node = node -> next;
-            }
+// Function to parse a '$' terminated list of comma separated integers into a normal linked list (stored in 'head')
+// Returns 0 if the list is malformed (the error is recorded in 'tok', and 'head' holds the integers before the error)
+int parse_list(Tokenizer *tok, Node **head)
+{
+    Node *node = *head = NULL;
+    while (tokenizer_peek(tok) != '$')
+    {
+        int val;
+        if (tokenizer_peek(tok) == -1)
+        {
+            return tokenizer_fail(tok, "missing '$' at the end of the list");
         }
-        else
+        if (!tokenizer_int(tok, &val) || !tokenizer_expect(tok, ','))
         {
-            // Insert the integer into the current chunk
-            node->arr[index] = atoi(num);
+            return 0;
         }
-        index++;
-        if (index == 8)
+
+        // Create a new node with value 'val' and append it to the list
+        Node *new_node = create_node();
+        new_node->val = val;
+        if (*head == NULL)
+        {
+            *head = node = new_node;
+        }
+        else
         {
-            index = 0; // Insert the next integer in the beginning of a new chunk
+            node -> next = new_node;
+            node = node -> next;
         }
     }
+    tok -> pos++; // skip the '$' character
+    return 1;
+}
+
+// Function which takes 'sequence' as input from the user
+// and stores it in a chunk list and returns the base address of that list
+Chunk* input_sequence()
+{
+    char *str = (char *) calloc(MAX_LEN, sizeof(char));
+    if (scanf("%9999s", str) != 1)
+    {
+        str[0] = 0;
+    }
+
+    // Parse the integers directly from 'str' into chunks
+    ChunkWriter writer = {NULL, NULL, NULL};
+    Tokenizer tok;
+    tokenizer_init(&tok, str, strlen(str));
+    if (!parse_sequence(&tok, &writer))
+    {
+        tokenizer_report(&tok, "Invalid sequence", stderr);
+        exit(1);
+    }
     free(str); // free memory which is no longer required
     // return the head node of the input sequence
+    return writer.head;
+}
+
+// Function which parses a '$' terminated list of comma separated integers (e.g. "1,2,3,$")
+// and stores it in a normal linked list and returns its base address (the program stops on a malformed list)
+Node* parse_LL(const char *str)
+{
+    Node *head;
+    Tokenizer tok;
+    tokenizer_init(&tok, str, strlen(str));
+    if (!parse_list(&tok, &head))
+    {
+        tokenizer_report(&tok, "Invalid list", stderr);
+        exit(1);
+    }
+    // return the head node of the parsed list
     return head;
 }
 
@@ -159,98 +428,138 @@ Chunk* input_sequence()
 Node* input_pattern()
 {
     char *str = (char *) calloc(MAX_LEN, sizeof(char));
-    scanf("%s", str);
+    if (scanf("%9999s", str) != 1)
+    {
+        str[0] = 0;
+    }
+
+    Node *head = parse_LL(str);
+    free(str); // free memory which is no longer required
+    return head;
+}
 
-    Node *head, *node;
-    head = node = NULL;
+// Comparison function for qsort over 64 bit keys
+int compare_keys(const void *a, const void *b)
+{
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
 
-    // Extract integers one-by-one and insert them into nodes
-    int i = 0; // 'index' represents the chunk index where integer has to be inserted
-    while (str[i] != '$')
+// Function to find the first index in arr[from..count-1] which holds 'val', and return 'count' if there is none.
+// This is the candidate filter used before matching: a position which doesn't hold the first integer of the pattern can't start a match.
+// Blocks of 8 (AVX2) or 4 (SSE2) integers are compared at once, and the comparison bitmask gives the first candidate in the block.
+int find_value(const int *arr, int from, int count, int val)
+{
+    int k = from;
+#if defined(__AVX2__) && defined(__GNUC__)
+    __m256i key8 = _mm256_set1_epi32(val);
+    for (; k + 8 <= count; k += 8)
     {
-        int j = 0;
-        char num[50] = "";
-        while (str[i] != ',')
+        __m256i block = _mm256_loadu_si256((const __m256i *) (arr + k));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, key8)));
+        if (mask != 0)
         {
-            num[j] = str[i];
-            j++;
-            i++;
+            return k + __builtin_ctz(mask);
         }
-        num[j] = 0; // Append NULL at the end of the string
-        i++; // skip the ',' character
-
-        // Create a new node with value 'num' and append it to the list
-        Node *new_node = create_node();
-        new_node->val = atoi(num);
-
-        if (head == NULL)
+    }
+#endif
+#if defined(__SSE2__) && defined(__GNUC__)
+    __m128i key4 = _mm_set1_epi32(val);
+    for (; k + 4 <= count; k += 4)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *) (arr + k));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, key4)));
+        if (mask != 0)
         {
-            head = node = new_node;
+            return k + __builtin_ctz(mask);
         }
-        else
+    }
+#endif
+    // Remaining integers (or all of them without SIMD support)
+    for (; k < count; k++)
+    {
+        if (arr[k] == val)
         {
-            node -> next = new_node;
-            node = node -> next;
+            return k;
         }
     }
-
-    free(str); // free memory which is no longer required
-    // return the head node of the input sequence
-    return head;
+    return count;
 }
 
 // Function to detect pattern in sequence in the given position (node,index)
-int match(Chunk *node, int index, Node *pattern)
+// The pattern is compared against whole runs of every chunk at once using memcmp (which is vectorised), instead of integer by integer
+int match(Chunk *node, int index, int *pattern, int length)
 {
-    int found = 1;
-    while (pattern != NULL)
+    while (length > 0)
     {
-        if (node == NULL || node->arr[index] == INT_MIN || pattern->val != node->arr[index])
+        if (node == NULL)
         {
-            found = 0;
-            break;
+            return 0;
         }
-        pattern = pattern->next;
-        index += 1;
-        if (index == 8)
+        int run = node->count - index;
+        if (run > length)
         {
-            node = node -> next;
-            index = 0;
+            run = length;
+        }
+        if (memcmp(node->arr + index, pattern, run * sizeof(int)) != 0)
+        {
+            return 0;
         }
+        pattern += run;
+        length -= run;
+        node = node -> next;
+        index = 0;
     }
-    return found;
+    return 1;
 }
 
 // Function to detect all patterns in a given sequence and print the positions where patterns are found
 // (I didn't use this function in the final program)
 void detect_all_patterns(Chunk *head, Node *pattern)
 {
+    // 'match' compares against an array, so copy the pattern into one
+    int length = 0;
+    for (Node *temp = pattern; temp != NULL; temp = temp -> next)
+    {
+        length++;
+    }
+    int *array = (int *) malloc((length > 0 ? length : 1) * sizeof(int));
+    length = 0;
+    for (Node *temp = pattern; temp != NULL; temp = temp -> next)
+    {
+        array[length++] = temp -> val;
+    }
+
     Chunk *node = head;
     int index = 0, node_count = 1;
 
-    while (node != NULL && node->arr[index] != INT_MIN)
+    while (node != NULL)
     {
-        int found = match(node, index, pattern);
-        if (found == 1)
+        if (length > 0)
         {
-            printf("Pattern found at Chunk %d, index %d.\n", node_count, index);
-            Node *temp = pattern;
-            while (temp != NULL)
+            // Jump to the next candidate position (holding the first integer of the pattern), skipping whole chunks if required
+            index = find_value(node -> arr, index, node -> count, array[0]);
+            if (index == node -> count)
             {
-                temp = temp -> next;
-                index += 1;
-                if (index == 8)
-                {
-                    node = node -> next;
-                    node_count += 1;
-                    index = 0;
-                }
+                node = node -> next;
+                node_count += 1;
+                index = 0;
+                continue;
             }
         }
-        else
+        int found = match(node, index, array, length);
+        int skip = 1;
+        if (found == 1)
+        {
+            printf("Pattern found at Chunk %d, index %d.\n", node_count, index);
+            skip = (length > 0) ? length : 1;
+        }
+        // Move past the matched integers (or one integer if there was no match)
+        while (skip > 0 && node != NULL)
         {
             index += 1;
-            if (index == 8)
+            skip -= 1;
+            if (index == node -> count)
             {
                 node = node -> next;
                 node_count += 1;
@@ -258,94 +567,195 @@ void detect_all_patterns(Chunk *head, Node *pattern)
             }
         }
     }
+    free(array);
 }
 
-// Function to insert replacement text at the beginning of the sequence in case 'pattern' is 'empty'
-Chunk* corner_case(Chunk *head1, Node *text)
+// Function to build the KMP matcher (pattern array and failure table) of a non-empty pattern in O(m) time
+Matcher* create_matcher(Node *pattern)
 {
-    Chunk *head2 = NULL; // head2 represents the head node of the replacement sequence
-    Chunk *node1 = head1; // For traversing original sequence
-    Chunk *node2 = head2; // For traversing replacement sequence
+    Matcher *matcher = (Matcher *) malloc(sizeof(Matcher));
+    matcher -> length = 0;
+    for (Node *node = pattern; node != NULL; node = node -> next)
+    {
+        matcher -> length += 1;
+    }
 
-    int index1 = 0;
-    int index2 = 0;
+    matcher -> pattern = (int *) malloc(matcher -> length * sizeof(int));
+    matcher -> failure = (int *) malloc(matcher -> length * sizeof(int));
+    int q = 0;
+    for (Node *node = pattern; node != NULL; node = node -> next)
+    {
+        matcher -> pattern[q] = node -> val;
+        q++;
+    }
 
-    // Insert 'text' in the replacement list
-    Node *node_t = text;
-    while (node_t != NULL)
+    // Standard KMP prefix function
+    matcher -> failure[0] = 0;
+    int k = 0;
+    for (q = 1; q < matcher -> length; q++)
     {
-        if (index2 == 0)
-        {
-            // Create a new empty chunk
-            Chunk *new_node = create_chunk_node();
-            new_node -> arr[index2] = node_t -> val;
-            if (head2 == NULL)
-            {
-                head2 = node2 = new_node;
-            }
-            else
-            {
-                node2 -> next = new_node;
-                node2 = node2 -> next;
-            }
-        }
-        else
+        while (k > 0 && matcher -> pattern[q] != matcher -> pattern[k])
         {
-            node2 -> arr[index2] = node_t -> val;
+            k = matcher -> failure[k - 1];
         }
-        index2 += 1;
-        if (index2 == 8)
+        if (matcher -> pattern[q] == matcher -> pattern[k])
         {
-            index2 = 0;
+            k++;
         }
-        node_t = node_t -> next;
+        matcher -> failure[q] = k;
     }
+    return matcher;
+}
+
+// function to free (deallocate memory) a KMP matcher
+void free_matcher(Matcher *matcher)
+{
+    free(matcher -> pattern);
+    free(matcher -> failure);
+    free(matcher);
+}
 
-    // Now insert the original sequence after the replacement text in the modified list
+void writer_flush(ChunkWriter *writer);
 
-    while (node1 != NULL && node1 -> arr[index1] != INT_MIN)
+// Function to append one integer at the end of the chunk list being built by 'writer'
+void writer_append(ChunkWriter *writer, int val)
+{
+    if (writer -> tail == NULL || (writer -> tail -> count == CHUNK_CAPACITY && writer -> stream == NULL))
     {
-        if (index2 == 0)
+        // previous chunk is full (or the list is empty), so create a new chunk
+        // (a streaming writer creates only one chunk, which is reused after every flush)
+        Chunk *new_node = create_chunk_node();
+        if (writer -> head == NULL)
         {
-            // Create a new empty chunk
-            Chunk *new_node = create_chunk_node();
-            new_node -> arr[index2] = node1 -> arr[index1];
-            if (head2 == NULL)
-            {
-                head2 = node2 = new_node;
-            }
-            else
-            {
-                node2 -> next = new_node;
-                node2 = node2 -> next;
-            }
+            writer -> head = writer -> tail = new_node;
         }
         else
         {
-            node2 -> arr[index2] = node1 -> arr[index1];
+            writer -> tail -> next = new_node;
+            writer -> tail = new_node;
+        }
+    }
+    writer -> tail -> arr[writer -> tail -> count] = val;
+    writer -> tail -> count += 1;
+    if (writer -> stream != NULL && writer -> tail -> count == CHUNK_CAPACITY)
+    {
+        // Streaming: emit the full chunk and reuse it for the next integers
+        writer_flush(writer);
+    }
+}
+
+// Function to print the chunk held by a streaming writer (in the same format as 'traverse_chunk_LL') and make it empty again
+void writer_flush(ChunkWriter *writer)
+{
+    Chunk *node = writer -> tail;
+    if (node == NULL || node -> count == 0)
+    {
+        return;
+    }
+    fprintf(writer -> stream, "-->(%d", node -> arr[0]);
+    for (int i = 1; i < node -> count; i++)
+    {
+        fprintf(writer -> stream, ",%d", node -> arr[i]);
+    }
+    fprintf(writer -> stream, ")");
+    node -> count = 0;
+}
+
+// Function to append the first 'count' integers of an array at the end of the chunk list being built by 'writer'
+// The integers are copied with one memcpy per chunk they are written to
+void writer_append_array(ChunkWriter *writer, int *values, int count)
+{
+    while (count > 0)
+    {
+        if (writer -> tail == NULL || writer -> tail -> count == CHUNK_CAPACITY)
+        {
+            // Let 'writer_append' deal with creating (or flushing) the chunk
+            writer_append(writer, *values);
+            values++;
+            count--;
+            continue;
         }
-        // Increment the second index (which points to the second list)
-        index2 += 1;
-        if (index2 == 8)
+        int run = CHUNK_CAPACITY - writer -> tail -> count;
+        if (run > count)
         {
-            index2 = 0;
+            run = count;
         }
-        
-        // Increment the first index 
-        index1 += 1;
-        if (index1 == 8)
+        memcpy(writer -> tail -> arr + writer -> tail -> count, values, run * sizeof(int));
+        writer -> tail -> count += run;
+        values += run;
+        count -= run;
+        if (writer -> stream != NULL && writer -> tail -> count == CHUNK_CAPACITY)
         {
-            index1 = 0;
-            node1 = node1 -> next;
+            writer_flush(writer);
         }
     }
+}
+
+// Function to append a normal linked list (e.g. the replacement 'text') at the end of the chunk list being built by 'writer'
+void writer_append_LL(ChunkWriter *writer, Node *node)
+{
+    while (node != NULL)
+    {
+        writer_append(writer, node -> val);
+        node = node -> next;
+    }
+}
+
+// Function to insert replacement text at the beginning of the sequence in case 'pattern' is 'empty'
+Chunk* corner_case(Chunk *head1, Node *text)
+{
+    ChunkWriter writer = {NULL, NULL, NULL}; // Builds the replacement sequence
+
+    // Insert 'text' in the replacement list
+    writer_append_LL(&writer, text);
+
+    // Now insert the original sequence after the replacement text in the modified list, one chunk at a time
+    for (Chunk *node1 = head1; node1 != NULL; node1 = node1 -> next)
+    {
+        writer_append_array(&writer, node1 -> arr, node1 -> count);
+    }
 
     // Now return the chunk list after performing replacements in the beginning (for empty pattern)
-    return head2;
+    return writer.head;
+}
+
+// Function to feed the next integer 'val' of the sequence to the KMP matcher, where '*q' is the number of pattern integers matched so far,
+// and write whatever is decided by this integer into 'writer' (the integers of a partial match are held back until the match fails or completes)
+void kmp_step(Matcher *matcher, int *q, int val, Node *text, ChunkWriter *writer)
+{
+    // On a mismatch, fall back to the longest prefix of the pattern that is still matched,
+    // and write the integers which dropped out of the partial match (they are the first q - failure[q - 1] integers of the pattern)
+    while (*q > 0 && val != matcher -> pattern[*q])
+    {
+        int fallback = matcher -> failure[*q - 1];
+        writer_append_array(writer, matcher -> pattern, *q - fallback);
+        *q = fallback;
+    }
+
+    if (val == matcher -> pattern[*q])
+    {
+        *q += 1;
+        if (*q == matcher -> length)
+        {
+            // Pattern detected in sequence, so insert 'text' in the replacement sequence and start matching afresh
+            writer_append_LL(writer, text);
+            *q = 0;
+        }
+    }
+    else
+    {
+        // Pattern cannot start at this position, so simply copy the value into the replacement sequence
+        writer_append(writer, val);
+    }
 }
 
+Chunk* replace_with_matcher(Chunk *head1, Matcher *matcher, Node *text);
+
 // Function to detect all patterns in a given sequence and replace it with given 'text'
 // Here 'head1' represents the head node of the original sequence
+// The sequence is scanned exactly once using KMP, so this takes O(n + m) time instead of O(n * m):
+// the integers of a partial match are never re-read from the sequence, since they are always equal to a prefix of the pattern.
+// Matches are replaced from left to right without overlapping (after a match, matching restarts right after the matched integers).
 Chunk* replace_all_patterns(Chunk *head1, Node *pattern, Node* text)
 {
     // Deal with the corner-case when the pattern itself is empty
@@ -355,113 +765,2561 @@ Chunk* replace_all_patterns(Chunk *head1, Node *pattern, Node* text)
         return corner_case(head1, text);
     }
 
-    Chunk *head2 = NULL; // 'head2' represents the head node of the replacement sequence
-    Chunk *node1 = head1; // For traversing original sequence
-    Chunk *node2 = head2; // For traversing replacement sequence
+    Matcher *matcher = create_matcher(pattern);
+    Chunk *result = replace_with_matcher(head1, matcher, text);
+    free_matcher(matcher);
+    return result;
+}
 
-    int index1 = 0; // Represents the current index in original sequence where we do pattern matching
-    int index2 = 0; // Represents the current index in replacement sequence where we insert integers after performing replacement
-    int node_count = 0; // Counts the number of sequence nodes traversed so far
+// Function to replace all matches of an already built (non-empty) KMP matcher, used by 'replace_all_patterns'
+// and wherever the same pattern is applied to many sequences
+Chunk* replace_with_matcher(Chunk *head1, Matcher *matcher, Node *text)
+{
+    ChunkWriter writer = {NULL, NULL, NULL}; // Builds the replacement sequence
+    int q = 0; // Number of integers of the pattern matched so far (these integers are not yet written to the replacement sequence)
 
-    while (node1 != NULL && node1->arr[index1] != INT_MIN)
+    for (Chunk *node1 = head1; node1 != NULL; node1 = node1 -> next)
     {
-        int found = match(node1, index1, pattern);
-        if (found == 1)
+        int index1 = 0;
+        while (index1 < node1->count)
         {
-            // Pattern detected in sequence, so insert 'text' in the replacement sequence
-            // First traverse the original sequence till the end of the pattern
-            
-            //printf("Pattern found at Chunk %d, index %d.\n", node_count, index1);
-            Node *node_p = pattern; // 'node_p' is a node to traverse the 'pattern'
-            while (node_p != NULL)
-            {
-                node_p = node_p -> next;
-                index1 += 1;
-                if (index1 == 8)
-                {
-                    node1 = node1 -> next;
-                    node_count += 1;
-                    index1 = 0;
-                }
-            }
-            
-            // Now insert 'text' into the replacment sequence
-            Node *node_t = text; // 'node_t' is a node to traverse 'text'
-            while (node_t != NULL)
+            if (q == 0)
             {
-                // Now insert node_t->val into replacement sequence's 'node2' at position 'index2'
-                if (index2 == 0)
-                {
-                    Chunk *new_node = create_chunk_node();
-                    new_node->arr[index2] = node_t -> val;
-                    if (head2 == NULL)
-                    {
-                        head2 = node2 = new_node;
-                    }
-                    else
-                    {
-                        node2 -> next = new_node;
-                        node2 = node2 -> next;
-                    }
-                }
-                else
-                {
-                    node2 -> arr[index2] = node_t -> val;
-                }
-                index2 += 1;
-                if (index2 == 8)
+                // No partial match: the integers before the next occurrence of pattern[0] in this chunk can't start a match,
+                // so copy them into the replacement sequence in bulk
+                int end = find_value(node1->arr, index1, node1->count, matcher -> pattern[0]);
+                writer_append_array(&writer, node1->arr + index1, end - index1);
+                index1 = end;
+                if (index1 == node1->count)
                 {
-                    index2 = 0;
+                    break;
                 }
-                node_t = node_t -> next;
             }
+            kmp_step(matcher, &q, node1->arr[index1], text, &writer);
+            index1++;
         }
-        else
-        {
-            // Pattern not found at this position
-            // So simply copy the value at current position in original sequence into replacement sequence
-            if (index2 == 0)
-            {
-                Chunk *new_node = create_chunk_node();
-                new_node->arr[index2] = node1->arr[index1];
-                if (head2 == NULL)
-                {
-                    head2 = node2 = new_node;
+    }
+
+    // The sequence ended in the middle of a partial match, so those integers are not replaced
+    writer_append_array(&writer, matcher -> pattern, q);
+
+    // Return the replacement sequence
+    return writer.head;
+}
+
+// Function to find the goto transition of 'state' on 'value' (returns -1 if there is no such transition)
+int ac_goto(Automaton *ac, int state, int value)
+{
+    long long key = ((long long) state << 32) | (unsigned int) value;
+    int slot = (int) ((key * 0x9E3779B97F4A7C15ULL) >> 40) & (ac -> edge_capacity - 1);
+    while (ac -> edge_keys[slot] != -1)
+    {
+        if (ac -> edge_keys[slot] == key)
+        {
+            return ac -> edge_targets[slot];
+        }
+        slot = (slot + 1) & (ac -> edge_capacity - 1);
+    }
+    return -1;
+}
+
+// Function to insert the goto transition (state, value) -> target into the hash table of transitions
+void ac_add_edge(Automaton *ac, int state, int value, int target)
+{
+    if (2 * (ac -> num_edges + 1) > ac -> edge_capacity)
+    {
+        // Keep the load factor below 1/2: rehash all the transitions into a table of double the size
+        long long *old_keys = ac -> edge_keys;
+        int *old_targets = ac -> edge_targets;
+        int old_capacity = ac -> edge_capacity;
+        ac -> edge_capacity *= 2;
+        ac -> edge_keys = (long long *) malloc(ac -> edge_capacity * sizeof(long long));
+        ac -> edge_targets = (int *) malloc(ac -> edge_capacity * sizeof(int));
+        memset(ac -> edge_keys, -1, ac -> edge_capacity * sizeof(long long));
+        ac -> num_edges = 0;
+        for (int slot = 0; slot < old_capacity; slot++)
+        {
+            if (old_keys[slot] != -1)
+            {
+                ac_add_edge(ac, (int) (old_keys[slot] >> 32), (int) (old_keys[slot] & 0xFFFFFFFF), old_targets[slot]);
+            }
+        }
+        free(old_keys);
+        free(old_targets);
+    }
+
+    long long key = ((long long) state << 32) | (unsigned int) value;
+    int slot = (int) ((key * 0x9E3779B97F4A7C15ULL) >> 40) & (ac -> edge_capacity - 1);
+    while (ac -> edge_keys[slot] != -1)
+    {
+        slot = (slot + 1) & (ac -> edge_capacity - 1);
+    }
+    ac -> edge_keys[slot] = key;
+    ac -> edge_targets[slot] = target;
+    ac -> num_edges += 1;
+}
+
+// Function to create a new state of the automaton (as a child of 'parent' on 'value') and return its number
+int ac_new_state(Automaton *ac, int parent, int value)
+{
+    if (ac -> num_states == ac -> capacity)
+    {
+        ac -> capacity *= 2;
+        ac -> states = (ACState *) realloc(ac -> states, ac -> capacity * sizeof(ACState));
+    }
+    int state = ac -> num_states;
+    ac -> num_states += 1;
+
+    ACState *new_state = &ac -> states[state];
+    new_state -> value = value;
+    new_state -> depth = (parent == -1) ? 0 : ac -> states[parent].depth + 1;
+    new_state -> first_child = -1;
+    new_state -> next_sibling = -1;
+    new_state -> fail = 0;
+    new_state -> output = -1;
+    new_state -> dict = -1;
+    if (parent != -1)
+    {
+        new_state -> next_sibling = ac -> states[parent].first_child;
+        ac -> states[parent].first_child = state;
+        ac_add_edge(ac, parent, value, state);
+    }
+    return state;
+}
+
+// Function to build the Aho-Corasick automaton of the given rules in O(total length of patterns) expected time
+// If two rules have the same pattern, the rule which comes first is used
+Automaton* create_automaton(Rule *rules, int num_rules)
+{
+    Automaton *ac = (Automaton *) malloc(sizeof(Automaton));
+    ac -> capacity = 16;
+    ac -> num_states = 0;
+    ac -> states = (ACState *) malloc(ac -> capacity * sizeof(ACState));
+    ac -> edge_capacity = 16;
+    ac -> num_edges = 0;
+    ac -> edge_keys = (long long *) malloc(ac -> edge_capacity * sizeof(long long));
+    ac -> edge_targets = (int *) malloc(ac -> edge_capacity * sizeof(int));
+    memset(ac -> edge_keys, -1, ac -> edge_capacity * sizeof(long long));
+    ac -> rules = rules;
+    ac -> num_rules = num_rules;
+    ac -> max_length = 0;
+    ac_new_state(ac, -1, 0); // root (state 0) represents the empty prefix
+
+    // Insert all the patterns into the trie
+    for (int r = 0; r < num_rules; r++)
+    {
+        int state = 0;
+        for (Node *node = rules[r].pattern; node != NULL; node = node -> next)
+        {
+            int next_state = ac_goto(ac, state, node -> val);
+            if (next_state == -1)
+            {
+                next_state = ac_new_state(ac, state, node -> val);
+            }
+            state = next_state;
+        }
+        if (ac -> states[state].output == -1)
+        {
+            ac -> states[state].output = r;
+        }
+        if (rules[r].length > ac -> max_length)
+        {
+            ac -> max_length = rules[r].length;
+        }
+    }
+
+    // Compute the failure and dictionary links in BFS order (the failure state of a state is always shallower)
+    int *queue = (int *) malloc(ac -> num_states * sizeof(int));
+    int front = 0, rear = 0;
+    for (int child = ac -> states[0].first_child; child != -1; child = ac -> states[child].next_sibling)
+    {
+        ac -> states[child].fail = 0;
+        queue[rear++] = child;
+    }
+    while (front < rear)
+    {
+        int state = queue[front++];
+        for (int child = ac -> states[state].first_child; child != -1; child = ac -> states[child].next_sibling)
+        {
+            int value = ac -> states[child].value;
+            int fail = ac -> states[state].fail;
+            while (fail != 0 && ac_goto(ac, fail, value) == -1)
+            {
+                fail = ac -> states[fail].fail;
+            }
+            int target = ac_goto(ac, fail, value);
+            ac -> states[child].fail = (target == -1) ? 0 : target;
+
+            int fail_state = ac -> states[child].fail;
+            ac -> states[child].dict = (ac -> states[fail_state].output != -1) ? fail_state : ac -> states[fail_state].dict;
+            queue[rear++] = child;
+        }
+    }
+    free(queue);
+    return ac;
+}
+
+// function to free (deallocate memory) an Aho-Corasick automaton (the rules are owned by the caller)
+void free_automaton(Automaton *ac)
+{
+    free(ac -> states);
+    free(ac -> edge_keys);
+    free(ac -> edge_targets);
+    free(ac);
+}
+
+// Function to apply all the rules of the automaton on a sequence in one pass, and return the replacement sequence
+// Priority rule for overlapping matches: the match which starts first (leftmost) wins; among matches starting at the same position,
+// the longest pattern wins; identical patterns are resolved in favour of the rule which comes first. Replaced integers are never rescanned.
+// A position is decided as soon as every pattern that could start there has ended, so only a window of 'max_length' integers is kept
+Chunk* replace_all_rules(Chunk *head1, Automaton *ac)
+{
+    ChunkWriter writer = {NULL, NULL, NULL};
+    int window = (ac -> max_length > 0) ? ac -> max_length : 1;
+    int *values = (int *) malloc(window * sizeof(int)); // values[pos % window] is the integer at position 'pos' of the sequence
+    int *best = (int *) malloc(window * sizeof(int)); // best[pos % window] is the rule of the longest match starting at 'pos' (-1 if none)
+
+    long long pos = 0; // position of the current integer in the sequence
+    long long skip_until = 0; // positions before this one are already consumed by a replacement
+    int state = 0;
+    Chunk *node1 = head1;
+    int index1 = 0;
+
+    while (1)
+    {
+        int at_end = (node1 == NULL);
+        if (!at_end)
+        {
+            int val = node1->arr[index1];
+            values[pos % window] = val;
+            best[pos % window] = -1;
+
+            // Advance the automaton, and record every pattern ending at 'pos' against the position where it starts
+            while (state != 0 && ac_goto(ac, state, val) == -1)
+            {
+                state = ac -> states[state].fail;
+            }
+            int next_state = ac_goto(ac, state, val);
+            state = (next_state == -1) ? 0 : next_state;
+
+            int out = (ac -> states[state].output != -1) ? state : ac -> states[state].dict;
+            while (out != -1)
+            {
+                int length = ac -> states[out].depth;
+                int slot = (int) ((pos - length + 1) % window);
+                if (best[slot] == -1 || ac -> rules[best[slot]].length < length)
+                {
+                    best[slot] = ac -> states[out].output;
+                }
+                out = ac -> states[out].dict;
+            }
+
+            next_position(&node1, &index1);
+        }
+
+        // Decide the positions whose matches are all known: position 'pos - window + 1' while scanning, and all the remaining positions at the end
+        long long first = pos - window + 1;
+        long long last = at_end ? pos - 1 : pos - window + 1;
+        for (long long decide = (first > 0) ? first : 0; decide <= last; decide++)
+        {
+            if (decide < skip_until)
+            {
+                continue; // already consumed by a replacement
+            }
+            int rule = best[decide % window];
+            if (rule != -1)
+            {
+                writer_append_LL(&writer, ac -> rules[rule].text);
+                skip_until = decide + ac -> rules[rule].length;
+            }
+            else
+            {
+                writer_append(&writer, values[decide % window]);
+            }
+        }
+
+        if (at_end)
+        {
+            break;
+        }
+        pos += 1;
+    }
+
+    free(values);
+    free(best);
+    return writer.head;
+}
+
+// Function to splice 'text' in place of the matched integers from position 'start' to position 'end' (both inclusive) of a chunk list.
+// The integers after 'end' in its chunk are moved right after the text, so only the chunks around the match are rewritten:
+// the chunks after start's chunk upto end's chunk are returned to 'free_chunks', and new chunks are taken from it first.
+// Returns the (possibly new) head of the list, and sets 'cursor' to the first integer after the replaced text.
+Chunk* splice_text(Chunk *head, Position start, Position end, Node *text, Chunk **free_chunks, Position *cursor)
+{
+    // Save the integers which follow the match in end's chunk
+    int tail[CHUNK_CAPACITY];
+    int tail_count = end.node -> count - end.index - 1;
+    memcpy(tail, end.node -> arr + end.index + 1, tail_count * sizeof(int));
+    Chunk *rest = end.node -> next;
+
+    // Chunks after start's chunk upto end's chunk only contained matched integers (and the saved tail)
+    if (end.node != start.node)
+    {
+        Chunk *node = start.node -> next;
+        while (node != rest)
+        {
+            Chunk *next_node = node -> next;
+            node -> next = *free_chunks;
+            *free_chunks = node;
+            node = next_node;
+        }
+    }
+
+    // Write 'text' followed by the saved tail from the start of the match, taking new chunks from the free list when start's chunk is full
+    Chunk *node = start.node, *prev = start.prev;
+    int index = start.index;
+    cursor -> node = NULL;
+    Node *node_t = text;
+    int k = 0;
+    while (node_t != NULL || k < tail_count)
+    {
+        if (index == CHUNK_CAPACITY)
+        {
+            node -> count = index;
+            Chunk *new_node = *free_chunks;
+            if (new_node != NULL)
+            {
+                *free_chunks = new_node -> next;
+                new_node -> next = NULL;
+            }
+            else
+            {
+                new_node = create_chunk_node();
+            }
+            node -> next = new_node;
+            prev = node;
+            node = new_node;
+            index = 0;
+        }
+        if (node_t != NULL)
+        {
+            node -> arr[index] = node_t -> val;
+            node_t = node_t -> next;
+        }
+        else
+        {
+            if (k == 0)
+            {
+                // the tail is not scanned yet, so scanning continues from here
+                cursor -> node = node;
+                cursor -> prev = prev;
+                cursor -> index = index;
+            }
+            node -> arr[index] = tail[k++];
+        }
+        index++;
+    }
+    node -> count = index;
+    node -> next = rest;
+
+    if (index == 0)
+    {
+        // Nothing was written and start's chunk became empty, so unlink it (chunks are never left empty)
+        if (prev == NULL)
+        {
+            head = rest;
+        }
+        else
+        {
+            prev -> next = rest;
+        }
+        node -> next = *free_chunks;
+        *free_chunks = node;
+        node = prev;
+    }
+
+    if (cursor -> node == NULL)
+    {
+        cursor -> node = rest;
+        cursor -> prev = node;
+        cursor -> index = 0;
+    }
+    return head;
+}
+
+// Function to replace all patterns in a given sequence with 'text' in place, and return the head of the modified sequence.
+// Unlike 'replace_all_patterns', unmatched integers are never copied: 'text' is spliced into the existing chunk list at every match,
+// splitting/merging chunks only around the match, so a sequence with few matches costs little more than the KMP scan itself.
+// The matches found are the same (left to right, non-overlapping), but chunks may be left partially filled.
+Chunk* replace_in_place(Chunk *head, Node *pattern, Node *text)
+{
+    // Empty pattern matches only at the beginning, so just link the chunks of 'text' before the sequence
+    if (pattern == NULL)
+    {
+        ChunkWriter writer = {NULL, NULL, NULL};
+        writer_append_LL(&writer, text);
+        if (writer.head == NULL)
+        {
+            return head;
+        }
+        writer.tail -> next = head;
+        return writer.head;
+    }
+
+    Matcher *matcher = create_matcher(pattern);
+    int m = matcher -> length;
+    Position *window = (Position *) malloc(m * sizeof(Position)); // window[k % m] is the position of the k-th scanned integer
+    Chunk *free_chunks = NULL;
+
+    Position current = {head, NULL, 0};
+    long long scanned = 0;
+    int q = 0;
+    while (current.node != NULL)
+    {
+        if (q == 0)
+        {
+            // No partial match, so skip the integers which can't start a match (they are left untouched)
+            current.index = find_value(current.node -> arr, current.index, current.node -> count, matcher -> pattern[0]);
+            if (current.index == current.node -> count)
+            {
+                current.prev = current.node;
+                current.node = current.node -> next;
+                current.index = 0;
+                continue;
+            }
+        }
+        int val = current.node -> arr[current.index];
+        window[scanned % m] = current;
+        scanned++;
+
+        while (q > 0 && val != matcher -> pattern[q])
+        {
+            q = matcher -> failure[q - 1];
+        }
+        if (val == matcher -> pattern[q])
+        {
+            q++;
+        }
+
+        if (q == m)
+        {
+            // Pattern found: the last m scanned integers are the match, and none of them has been modified since it was scanned
+            head = splice_text(head, window[(scanned - m) % m], current, text, &free_chunks, &current);
+            q = 0;
+            continue;
+        }
+
+        Chunk *node = current.node;
+        next_position(&current.node, &current.index);
+        if (current.node != node)
+        {
+            current.prev = node;
+        }
+    }
+
+    free_chunk_LL(free_chunks);
+    free(window);
+    free_matcher(matcher);
+    return head;
+}
+
+// Maximum number of threads used by the parallel mode
+#define MAX_THREADS 64
+
+// A range of whole chunks of the sequence, processed by one thread in the parallel mode
+typedef struct Segment
+{
+    Chunk *first; // first chunk of the segment
+    Chunk *end; // chunk after the last chunk of the segment (NULL for the last segment)
+    long long start; // position (in the whole sequence) of the first integer of the segment
+    Matcher *matcher;
+    Node *text;
+    long long *matches; // end positions of the matches found by scanning the segment on its own
+    int num_matches, capacity;
+    int exit_q; // KMP state at the end of the segment, when scanned on its own
+    long long *starts; // start positions of all the (final) matches of the whole sequence
+    int first_match, last_match; // matches starting in this segment are starts[first_match..last_match-1]
+    ChunkWriter writer; // replacement of this segment
+    Pool pool; // pool of the chunks of 'writer'
+} Segment;
+
+// Function to feed one integer to a KMP matcher in state 'q' (number of integers matched), and return the new state.
+// A return value equal to the pattern length means that a match ends at this integer.
+int kmp_next(Matcher *matcher, int q, int val)
+{
+    if (q == matcher -> length)
+    {
+        q = 0; // Matches don't overlap, so matching restarts afresh after a match
+    }
+    while (q > 0 && val != matcher -> pattern[q])
+    {
+        q = matcher -> failure[q - 1];
+    }
+    if (val == matcher -> pattern[q])
+    {
+        q++;
+    }
+    return q;
+}
+
+// Phase 1 of the parallel replacement (runs in a worker thread): scan one segment with KMP as if no match was pending at its start,
+// and record the end position of every match found
+void* scan_segment(void *arg)
+{
+    Segment *segment = (Segment *) arg;
+    Matcher *matcher = segment -> matcher;
+    long long pos = segment -> start;
+    int q = 0;
+    for (Chunk *node = segment -> first; node != segment -> end; node = node -> next)
+    {
+        int index = 0;
+        while (index < node -> count)
+        {
+            if (q == 0 || q == matcher -> length)
+            {
+                // Skip the integers which can't start a match
+                int next = find_value(node -> arr, index, node -> count, matcher -> pattern[0]);
+                pos += next - index;
+                index = next;
+                q = 0;
+                if (index == node -> count)
+                {
+                    break;
+                }
+            }
+            q = kmp_next(matcher, q, node -> arr[index]);
+            if (q == matcher -> length)
+            {
+                if (segment -> num_matches == segment -> capacity)
+                {
+                    segment -> capacity = (segment -> capacity > 0) ? 2 * segment -> capacity : 64;
+                    segment -> matches = (long long *) realloc(segment -> matches, segment -> capacity * sizeof(long long));
+                }
+                segment -> matches[segment -> num_matches++] = pos;
+            }
+            index++;
+            pos++;
+        }
+    }
+    segment -> exit_q = (q == matcher -> length) ? 0 : q;
+    return NULL;
+}
+
+// Phase 2 of the parallel replacement (sequential): correct the matches of every segment for the partial match pending at its start.
+// The true scan (entering the segment in state q) and the segment's own scan (entering in state 0) are run side by side until
+// their states become equal; from there on both scans are identical, so the rest of the segment's own matches are valid.
+// Normally the states agree within m integers; in the worst case (e.g. pattern 1,1 in a run of 1s) the whole segment is rescanned.
+// Returns the number of matches, and stores their start positions (in increasing order) in 'starts'.
+int resolve_segments(Segment *segments, int num_segments, Matcher *matcher, long long **starts)
+{
+    int m = matcher -> length;
+    int num_starts = 0, capacity = 64;
+    *starts = (long long *) malloc(capacity * sizeof(long long));
+    int q = 0; // state of the true scan at the start of the current segment
+
+    for (int t = 0; t < num_segments; t++)
+    {
+        Segment *segment = &segments[t];
+        long long pos = segment -> start;
+        long long synced_at = pos - 1; // the segment's own matches ending after this position are valid
+        int synced = (q == 0), own_q = 0;
+
+        Chunk *node = segment -> first;
+        int index = 0;
+        while (!synced && node != segment -> end)
+        {
+            int val = node -> arr[index];
+            q = kmp_next(matcher, q, val);
+            own_q = kmp_next(matcher, own_q, val);
+            if (q == m)
+            {
+                if (num_starts == capacity)
+                {
+                    capacity *= 2;
+                    *starts = (long long *) realloc(*starts, capacity * sizeof(long long));
+                }
+                (*starts)[num_starts++] = pos - m + 1;
+            }
+            if (q % m == own_q % m) // (state m is the same as state 0)
+            {
+                synced = 1;
+                synced_at = pos;
+            }
+            pos++;
+            if (++index == node -> count)
+            {
+                node = node -> next;
+                index = 0;
+            }
+        }
+
+        if (synced)
+        {
+            for (int k = 0; k < segment -> num_matches; k++)
+            {
+                if (segment -> matches[k] > synced_at)
+                {
+                    if (num_starts == capacity)
+                    {
+                        capacity *= 2;
+                        *starts = (long long *) realloc(*starts, capacity * sizeof(long long));
+                    }
+                    (*starts)[num_starts++] = segment -> matches[k] - m + 1;
+                }
+            }
+            q = segment -> exit_q;
+        }
+        else
+        {
+            q = q % m; // the whole segment was rescanned, so q is already the true state at its end
+        }
+    }
+    return num_starts;
+}
+
+// Phase 3 of the parallel replacement (runs in a worker thread): build the replacement of one segment from the final matches.
+// A match starting in an earlier segment may cover the first few integers of this segment; those are skipped.
+void* build_segment(void *arg)
+{
+    Segment *segment = (Segment *) arg;
+    thread_chunk_pool = &segment -> pool;
+    int m = segment -> matcher -> length;
+    long long *starts = segment -> starts;
+    int k = segment -> first_match;
+    long long skip_until = (k > 0) ? starts[k - 1] + m : 0; // integers before this position were replaced by a match
+    long long pos = segment -> start;
+
+    for (Chunk *node = segment -> first; node != segment -> end; node = node -> next)
+    {
+        int index = 0;
+        while (index < node -> count)
+        {
+            if (k < segment -> last_match && starts[k] == pos)
+            {
+                writer_append_LL(&segment -> writer, segment -> text);
+                skip_until = pos + m;
+                k++;
+            }
+            int run = node -> count - index;
+            if (pos < skip_until)
+            {
+                // Drop the matched integers
+                if (skip_until - pos < run)
+                {
+                    run = (int) (skip_until - pos);
+                }
+            }
+            else
+            {
+                // Copy the integers before the next match
+                if (k < segment -> last_match && starts[k] - pos < run)
+                {
+                    run = (int) (starts[k] - pos);
+                }
+                writer_append_array(&segment -> writer, node -> arr + index, run);
+            }
+            index += run;
+            pos += run;
+        }
+    }
+    thread_chunk_pool = &chunk_pool;
+    return NULL;
+}
+
+// Function to replace all patterns in a given sequence with 'text' using 'num_threads' threads, and return the replacement sequence.
+// The chunks are split into contiguous segments, which are scanned in parallel (phase 1), the matches are corrected for partial matches
+// crossing segment boundaries in one sequential pass over the boundaries (phase 2), and the segments are rebuilt in parallel (phase 3).
+// The matches are exactly those of 'replace_all_patterns', so the integers of the result are identical; the per-segment lists are
+// linked in O(1) each, so the last chunk of a segment may be partially filled.
+Chunk* replace_all_patterns_parallel(Chunk *head1, Node *pattern, Node *text, int num_threads)
+{
+    if (pattern == NULL)
+    {
+        return corner_case(head1, text);
+    }
+
+    int num_chunks = 0;
+    for (Chunk *node = head1; node != NULL; node = node -> next)
+    {
+        num_chunks++;
+    }
+    int num_segments = (num_threads < num_chunks) ? num_threads : num_chunks;
+    if (num_segments > MAX_THREADS)
+    {
+        num_segments = MAX_THREADS;
+    }
+    if (num_segments <= 1)
+    {
+        return replace_all_patterns(head1, pattern, text);
+    }
+
+    // Split the chunks into segments of (almost) equal number of chunks
+    Matcher *matcher = create_matcher(pattern);
+    Segment *segments = (Segment *) calloc(num_segments, sizeof(Segment));
+    Chunk *node = head1;
+    long long pos = 0;
+    for (int t = 0; t < num_segments; t++)
+    {
+        Segment *segment = &segments[t];
+        segment -> first = node;
+        segment -> start = pos;
+        segment -> matcher = matcher;
+        segment -> text = text;
+        segment -> pool = (Pool) {chunk_pool.object_size, chunk_pool.alignment, NULL, NULL, 0, NULL, 0, 0, 0, 0, 0};
+        int size = num_chunks / num_segments + (t < num_chunks % num_segments);
+        pool_lend(&segment -> pool, &chunk_pool, size + 1); // enough chunks for the replacement, unless 'text' is longer than 'pattern'
+        for (int c = 0; c < size; c++)
+        {
+            pos += node -> count;
+            node = node -> next;
+        }
+        segment -> end = node;
+    }
+
+    pthread_t threads[MAX_THREADS];
+    for (int t = 0; t < num_segments; t++)
+    {
+        pthread_create(&threads[t], NULL, scan_segment, &segments[t]);
+    }
+    for (int t = 0; t < num_segments; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    long long *starts;
+    int num_starts = resolve_segments(segments, num_segments, matcher, &starts);
+
+    int k = 0;
+    for (int t = 0; t < num_segments; t++)
+    {
+        segments[t].starts = starts;
+        segments[t].first_match = k;
+        long long end = (t + 1 < num_segments) ? segments[t + 1].start : LLONG_MAX;
+        while (k < num_starts && starts[k] < end)
+        {
+            k++;
+        }
+        segments[t].last_match = k;
+        pthread_create(&threads[t], NULL, build_segment, &segments[t]);
+    }
+    for (int t = 0; t < num_segments; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    // Link the replacements of the segments one after the other, and hand their chunks over to the global pool
+    Chunk *head = NULL, *tail = NULL;
+    for (int t = 0; t < num_segments; t++)
+    {
+        Segment *segment = &segments[t];
+        pool_absorb(&chunk_pool, &segment -> pool);
+        if (segment -> writer.head == NULL)
+        {
+            continue;
+        }
+        if (head == NULL)
+        {
+            head = segment -> writer.head;
+        }
+        else
+        {
+            tail -> next = segment -> writer.head;
+        }
+        tail = segment -> writer.tail;
+    }
+
+    for (int t = 0; t < num_segments; t++)
+    {
+        free(segments[t].matches);
+    }
+
+    free(starts);
+    free(segments);
+    free_matcher(matcher);
+    return head;
+}
+
+// Query API: positions (0-based offsets in the whole sequence) of all the occurrences of a pattern, including overlapping ones.
+// The empty pattern occurs only at position 0 (as in the replacement functions).
+
+// Function to find the first 'limit' occurrences of 'pattern' in a sequence by one KMP scan, and store their positions in 'positions'.
+// Scanning stops as soon as 'limit' occurrences are found; if 'positions' is NULL, occurrences are only counted (and 'limit' is ignored).
+// Returns the number of occurrences found
+long long find_matches(Chunk *head, Node *pattern, long long *positions, long long limit)
+{
+    if (pattern == NULL)
+    {
+        if (positions != NULL && limit > 0)
+        {
+            positions[0] = 0;
+        }
+        return (positions == NULL || limit > 0) ? 1 : 0;
+    }
+    if (positions != NULL && limit <= 0)
+    {
+        return 0;
+    }
+
+    Matcher *matcher = create_matcher(pattern);
+    int m = matcher -> length;
+    long long found = 0, pos = 0;
+    int q = 0;
+    for (Chunk *node = head; node != NULL; node = node -> next)
+    {
+        int index = 0;
+        while (index < node -> count)
+        {
+            if (q == 0)
+            {
+                // Skip the integers which can't start a match
+                int next = find_value(node -> arr, index, node -> count, matcher -> pattern[0]);
+                pos += next - index;
+                index = next;
+                if (index == node -> count)
+                {
+                    break;
+                }
+            }
+            int val = node -> arr[index];
+            while (q > 0 && val != matcher -> pattern[q])
+            {
+                q = matcher -> failure[q - 1];
+            }
+            if (val == matcher -> pattern[q])
+            {
+                q++;
+            }
+            if (q == m)
+            {
+                if (positions != NULL)
+                {
+                    positions[found] = pos - m + 1;
+                }
+                found++;
+                if (positions != NULL && found == limit)
+                {
+                    free_matcher(matcher);
+                    return found;
+                }
+                q = matcher -> failure[m - 1]; // occurrences may overlap
+            }
+            index++;
+            pos++;
+        }
+    }
+    free_matcher(matcher);
+    return found;
+}
+
+// Function to count the occurrences of 'pattern' in a sequence
+long long count_matches(Chunk *head, Node *pattern)
+{
+    return find_matches(head, pattern, NULL, 0);
+}
+
+// Suffix array of a sequence, used to answer many queries against the same sequence in O(m log n) each instead of rescanning it
+typedef struct MatchIndex
+{
+    int *values; // the sequence copied into an array
+    int *suffixes; // starting positions of all the suffixes of the sequence, in lexicographic order
+    int length;
+} MatchIndex;
+
+// Function to build the suffix array of a sequence by prefix doubling: after the round for 'k', suffixes are sorted by their first 2k integers.
+// Every round is two stable counting sorts (by the rank of the second half, then of the first half), so it takes O(n log n) time overall.
+MatchIndex* build_match_index(Chunk *head)
+{
+    MatchIndex *index = (MatchIndex *) malloc(sizeof(MatchIndex));
+    int n = 0;
+    for (Chunk *node = head; node != NULL; node = node -> next)
+    {
+        n += node -> count;
+    }
+    index -> length = n;
+    index -> values = (int *) malloc((n > 0 ? n : 1) * sizeof(int));
+    index -> suffixes = (int *) malloc((n > 0 ? n : 1) * sizeof(int));
+    n = 0;
+    for (Chunk *node = head; node != NULL; node = node -> next)
+    {
+        memcpy(index -> values + n, node -> arr, node -> count * sizeof(int));
+        n += node -> count;
+    }
+    if (n == 0)
+    {
+        return index;
+    }
+
+    int *sa = index -> suffixes;
+    int *rank = (int *) malloc(n * sizeof(int));
+    int *next_rank = (int *) malloc(n * sizeof(int));
+    int *order = (int *) malloc(n * sizeof(int));
+    int *counts = (int *) malloc((n + 1) * sizeof(int));
+
+    // Round 0: rank the suffixes by their first integer (positions are sorted by the 64 bit keys value * 2^32 + position)
+    long long *keys = (long long *) malloc(n * sizeof(long long));
+    for (int i = 0; i < n; i++)
+    {
+        keys[i] = (long long) index -> values[i] * 4294967296LL + i;
+    }
+    qsort(keys, n, sizeof(long long), compare_keys);
+    int ranks = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sa[i] = (int) (keys[i] & 0xFFFFFFFF);
+        if (i > 0 && index -> values[sa[i]] != index -> values[sa[i - 1]])
+        {
+            ranks++;
+        }
+        rank[sa[i]] = ranks;
+    }
+    ranks++;
+    free(keys);
+
+    for (int k = 1; ranks < n; k *= 2)
+    {
+        // Order by the second half: suffixes without a second half come first, then the others in the order of their second half
+        int t = 0;
+        for (int i = n - k; i < n; i++)
+        {
+            order[t++] = i;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            if (sa[i] >= k)
+            {
+                order[t++] = sa[i] - k;
+            }
+        }
+
+        // Stable counting sort by the first half
+        memset(counts, 0, (ranks + 1) * sizeof(int));
+        for (int i = 0; i < n; i++)
+        {
+            counts[rank[i] + 1]++;
+        }
+        for (int r = 0; r < ranks; r++)
+        {
+            counts[r + 1] += counts[r];
+        }
+        for (int i = 0; i < n; i++)
+        {
+            sa[counts[rank[order[i]]]++] = order[i];
+        }
+
+        // New ranks: suffixes get the same rank only if both halves have the same ranks
+        next_rank[sa[0]] = 0;
+        ranks = 1;
+        for (int i = 1; i < n; i++)
+        {
+            int a = sa[i - 1], b = sa[i];
+            int second_a = (a + k < n) ? rank[a + k] : -1;
+            int second_b = (b + k < n) ? rank[b + k] : -1;
+            if (rank[a] != rank[b] || second_a != second_b)
+            {
+                ranks++;
+            }
+            next_rank[b] = ranks - 1;
+        }
+        int *temp = rank;
+        rank = next_rank;
+        next_rank = temp;
+    }
+
+    free(rank);
+    free(next_rank);
+    free(order);
+    free(counts);
+    return index;
+}
+
+// function to free (deallocate memory) a match index
+void free_match_index(MatchIndex *index)
+{
+    free(index -> values);
+    free(index -> suffixes);
+    free(index);
+}
+
+// Function to compare the suffix starting at 'start' with the pattern 'pattern[0..m-1]'
+// Returns a negative number, 0 or a positive number if the suffix is smaller than, starts with, or is greater than the pattern
+int compare_suffix(MatchIndex *index, int start, int *pattern, int m)
+{
+    for (int k = 0; k < m; k++)
+    {
+        if (start + k == index -> length)
+        {
+            return -1; // the suffix is a proper prefix of the pattern
+        }
+        int val = index -> values[start + k];
+        if (val != pattern[k])
+        {
+            return (val < pattern[k]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Function to find the range suffixes[*first .. *last - 1] of the suffixes which start with 'pattern', by two binary searches
+void index_range(MatchIndex *index, Matcher *matcher, int *first, int *last)
+{
+    int low = 0, high = index -> length;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (compare_suffix(index, index -> suffixes[mid], matcher -> pattern, matcher -> length) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    *first = low;
+    high = index -> length;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (compare_suffix(index, index -> suffixes[mid], matcher -> pattern, matcher -> length) <= 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    *last = low;
+}
+
+// Function to count the occurrences of 'pattern' using a match index in O(m log n) time
+long long index_count_matches(MatchIndex *index, Node *pattern)
+{
+    if (pattern == NULL)
+    {
+        return 1;
+    }
+    Matcher *matcher = create_matcher(pattern);
+    int first, last;
+    index_range(index, matcher, &first, &last);
+    free_matcher(matcher);
+    return last - first;
+}
+
+// Function to find the first 'limit' occurrences (in increasing order of position) of 'pattern' using a match index,
+// and store their positions in 'positions'. Returns the number of positions stored.
+long long index_find_matches(MatchIndex *index, Node *pattern, long long *positions, long long limit)
+{
+    if (limit <= 0)
+    {
+        return 0;
+    }
+    if (pattern == NULL)
+    {
+        positions[0] = 0;
+        return 1;
+    }
+    Matcher *matcher = create_matcher(pattern);
+    int first, last;
+    index_range(index, matcher, &first, &last);
+    free_matcher(matcher);
+
+    // The suffixes of the range are in lexicographic order, so sort their positions
+    long long *found = (long long *) malloc((last > first ? last - first : 1) * sizeof(long long));
+    for (int k = first; k < last; k++)
+    {
+        found[k - first] = index -> suffixes[k];
+    }
+    qsort(found, last - first, sizeof(long long), compare_keys);
+    long long count = (last - first < limit) ? last - first : limit;
+    memcpy(positions, found, count * sizeof(long long));
+    free(found);
+    return count;
+}
+
+// Function to print the number of occurrences of 'pattern' and the positions of the first few of them
+void print_matches(long long count, long long *positions, long long shown)
+{
+    printf("Found %lld occurrence(s)", count);
+    for (long long k = 0; k < shown; k++)
+    {
+        printf("%s%lld", (k == 0) ? " at positions " : ", ", positions[k]);
+    }
+    printf("%s\n", (shown < count) ? ", ..." : "");
+}
+
+// Immutable array of integers shared by the pieces of ropes (freed when the last piece using it is freed)
+typedef struct RopeBuffer
+{
+    int refs;
+    int values[];
+} RopeBuffer;
+
+// Persistent rope (piece table kept in a treap): every node is one piece, i.e. a range of a RopeBuffer, and the sequence is the
+// in-order concatenation of the pieces. Nodes are never modified after they are created: an edit copies only the O(log n) nodes
+// on its path and shares everything else, so older versions stay valid. Nodes are reference counted, since they are shared.
+typedef struct Rope
+{
+    struct Rope *left, *right;
+    RopeBuffer *buffer;
+    int offset, length; // the piece is buffer->values[offset .. offset + length - 1]
+    long long size; // number of integers in this subtree
+    unsigned priority; // treap priority (a node's priority is higher than those of its children)
+    int refs;
+} Rope;
+
+// Function to return the number of integers in a rope
+long long rope_length(Rope *rope)
+{
+    return (rope != NULL) ? rope -> size : 0;
+}
+
+// Function to generate treap priorities (xorshift, so that the shape of a rope doesn't depend on the edits)
+unsigned rope_priority()
+{
+    static _Thread_local unsigned state = 2463534242u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Function to take one more reference to a rope (returns 'rope' for convenience)
+Rope* rope_retain(Rope *rope)
+{
+    if (rope != NULL)
+    {
+        rope -> refs += 1;
+    }
+    return rope;
+}
+
+// Function to drop a reference to a rope, freeing the nodes (and buffers) which are no longer used by any version
+void rope_release(Rope *rope)
+{
+    while (rope != NULL && --rope -> refs == 0)
+    {
+        Rope *right = rope -> right;
+        rope_release(rope -> left);
+        if (--rope -> buffer -> refs == 0)
+        {
+            free(rope -> buffer);
+        }
+        free(rope);
+        rope = right; // loop instead of recursing on the right child
+    }
+}
+
+// Function to create a rope node for a piece of 'buffer' with the given children (the references to the children are taken over)
+Rope* rope_node(Rope *left, Rope *right, RopeBuffer *buffer, int offset, int length, unsigned priority)
+{
+    Rope *rope = (Rope *) malloc(sizeof(Rope));
+    rope -> left = left;
+    rope -> right = right;
+    rope -> buffer = buffer;
+    buffer -> refs += 1;
+    rope -> offset = offset;
+    rope -> length = length;
+    rope -> size = rope_length(left) + length + rope_length(right);
+    rope -> priority = priority;
+    rope -> refs = 1;
+    return rope;
+}
+
+// Function to create a rope holding a copy of the first 'count' integers of 'values' (NULL if 'count' is 0)
+Rope* rope_from_array(int *values, int count)
+{
+    if (count <= 0)
+    {
+        return NULL;
+    }
+    RopeBuffer *buffer = (RopeBuffer *) malloc(sizeof(RopeBuffer) + count * sizeof(int));
+    buffer -> refs = 0;
+    memcpy(buffer -> values, values, count * sizeof(int));
+    return rope_node(NULL, NULL, buffer, 0, count, rope_priority());
+}
+
+// Function to create a rope from a chunk list (the whole sequence becomes one piece)
+Rope* rope_from_chunks(Chunk *head)
+{
+    long long n = 0;
+    for (Chunk *node = head; node != NULL; node = node -> next)
+    {
+        n += node -> count;
+    }
+    int *values = (int *) malloc((n > 0 ? n : 1) * sizeof(int));
+    n = 0;
+    for (Chunk *node = head; node != NULL; node = node -> next)
+    {
+        memcpy(values + n, node -> arr, node -> count * sizeof(int));
+        n += node -> count;
+    }
+    Rope *rope = rope_from_array(values, (int) n);
+    free(values);
+    return rope;
+}
+
+// Function to create a rope from a normal linked list
+Rope* rope_from_LL(Node *node)
+{
+    int n = 0;
+    for (Node *temp = node; temp != NULL; temp = temp -> next)
+    {
+        n++;
+    }
+    int *values = (int *) malloc((n > 0 ? n : 1) * sizeof(int));
+    n = 0;
+    for (Node *temp = node; temp != NULL; temp = temp -> next)
+    {
+        values[n++] = temp -> val;
+    }
+    Rope *rope = rope_from_array(values, n);
+    free(values);
+    return rope;
+}
+
+// Function to concatenate two ropes (neither is modified) and return the new rope
+Rope* rope_concat(Rope *a, Rope *b)
+{
+    if (a == NULL)
+    {
+        return rope_retain(b);
+    }
+    if (b == NULL)
+    {
+        return rope_retain(a);
+    }
+    if (a -> priority > b -> priority)
+    {
+        return rope_node(rope_retain(a -> left), rope_concat(a -> right, b), a -> buffer, a -> offset, a -> length, a -> priority);
+    }
+    return rope_node(rope_concat(a, b -> left), rope_retain(b -> right), b -> buffer, b -> offset, b -> length, b -> priority);
+}
+
+// Function to split a rope (which is not modified) into the first 'k' integers ('left') and the rest ('right')
+void rope_split(Rope *rope, long long k, Rope **left, Rope **right)
+{
+    if (k <= 0)
+    {
+        *left = NULL;
+        *right = rope_retain(rope);
+        return;
+    }
+    if (k >= rope_length(rope))
+    {
+        *left = rope_retain(rope);
+        *right = NULL;
+        return;
+    }
+    long long left_size = rope_length(rope -> left);
+    if (k <= left_size)
+    {
+        Rope *rest;
+        rope_split(rope -> left, k, left, &rest);
+        *right = rope_node(rest, rope_retain(rope -> right), rope -> buffer, rope -> offset, rope -> length, rope -> priority);
+    }
+    else if (k >= left_size + rope -> length)
+    {
+        Rope *rest;
+        rope_split(rope -> right, k - left_size - rope -> length, &rest, right);
+        *left = rope_node(rope_retain(rope -> left), rest, rope -> buffer, rope -> offset, rope -> length, rope -> priority);
+    }
+    else
+    {
+        // The split falls inside this node's piece, so the piece is cut into two pieces of the same buffer
+        int cut = (int) (k - left_size);
+        Rope *first = rope_node(NULL, NULL, rope -> buffer, rope -> offset, cut, rope_priority());
+        Rope *second = rope_node(NULL, NULL, rope -> buffer, rope -> offset + cut, rope -> length - cut, rope_priority());
+        *left = rope_concat(rope -> left, first);
+        *right = rope_concat(second, rope -> right);
+        rope_release(first);
+        rope_release(second);
+    }
+}
+
+// Function to replace the 'length' integers starting at 'offset' with the integers of 'text' in O(log n) time (plus the length of 'text'),
+// and return the new version (the old version is not modified). Insertion is replacement of 0 integers, deletion is replacement with empty text.
+Rope* rope_replace(Rope *rope, long long offset, long long length, Node *text)
+{
+    Rope *before, *rest, *removed, *after;
+    rope_split(rope, offset, &before, &rest);
+    rope_split(rest, length, &removed, &after);
+    Rope *inserted = rope_from_LL(text);
+    Rope *temp = rope_concat(before, inserted);
+    Rope *result = rope_concat(temp, after);
+    rope_release(before);
+    rope_release(rest);
+    rope_release(removed);
+    rope_release(after);
+    rope_release(inserted);
+    rope_release(temp);
+    return result;
+}
+
+// Function to insert 'text' before the integer at 'offset'
+Rope* rope_insert(Rope *rope, long long offset, Node *text)
+{
+    return rope_replace(rope, offset, 0, text);
+}
+
+// Function to delete the 'length' integers starting at 'offset'
+Rope* rope_delete(Rope *rope, long long offset, long long length)
+{
+    return rope_replace(rope, offset, length, NULL);
+}
+
+// Function to append the integers of a rope (in order) to the chunk list being built by 'writer'
+void rope_write(Rope *rope, ChunkWriter *writer)
+{
+    while (rope != NULL)
+    {
+        rope_write(rope -> left, writer);
+        writer_append_array(writer, rope -> buffer -> values + rope -> offset, rope -> length);
+        rope = rope -> right;
+    }
+}
+
+// Function to flatten a rope into a new chunk list
+Chunk* rope_to_chunks(Rope *rope)
+{
+    ChunkWriter writer = {NULL, NULL, NULL};
+    rope_write(rope, &writer);
+    return writer.head;
+}
+
+// Function to feed the integers of a rope to a KMP matcher (state 'q'), and record the start of every (non-overlapping) match in 'starts'
+void rope_scan(Rope *rope, Matcher *matcher, int *q, long long *pos, long long **starts, int *num_starts, int *capacity)
+{
+    while (rope != NULL)
+    {
+        rope_scan(rope -> left, matcher, q, pos, starts, num_starts, capacity);
+        int *values = rope -> buffer -> values + rope -> offset;
+        for (int k = 0; k < rope -> length; k++, (*pos)++)
+        {
+            if (*q == 0 || *q == matcher -> length)
+            {
+                // Skip the integers which can't start a match
+                int next = find_value(values, k, rope -> length, matcher -> pattern[0]);
+                *pos += next - k;
+                k = next;
+                *q = 0;
+                if (k == rope -> length)
+                {
+                    break;
+                }
+            }
+            *q = kmp_next(matcher, *q, values[k]);
+            if (*q == matcher -> length)
+            {
+                if (*num_starts == *capacity)
+                {
+                    *capacity = (*capacity > 0) ? 2 * *capacity : 16;
+                    *starts = (long long *) realloc(*starts, *capacity * sizeof(long long));
+                }
+                (*starts)[(*num_starts)++] = *pos - matcher -> length + 1;
+            }
+        }
+        rope = rope -> right;
+    }
+}
+
+// Function to replace all patterns in a rope with 'text' (same matches as 'replace_all_patterns'), and return the new version.
+// The sequence is still scanned once, but only the pieces around the matches are rebuilt: O(n + k log n) time for k matches,
+// and the new version shares all the unchanged pieces with the old one.
+Rope* rope_replace_all(Rope *rope, Node *pattern, Node *text)
+{
+    if (pattern == NULL)
+    {
+        return rope_insert(rope, 0, text);
+    }
+    Matcher *matcher = create_matcher(pattern);
+    long long *starts = NULL, pos = 0;
+    int num_starts = 0, capacity = 0, q = 0;
+    rope_scan(rope, matcher, &q, &pos, &starts, &num_starts, &capacity);
+
+    // Replace from the last match to the first, so that the offsets of the remaining matches don't change
+    Rope *result = rope_retain(rope);
+    for (int k = num_starts - 1; k >= 0; k--)
+    {
+        Rope *next = rope_replace(result, starts[k], matcher -> length, text);
+        rope_release(result);
+        result = next;
+    }
+    free(starts);
+    free_matcher(matcher);
+    return result;
+}
+
+// Number of jobs handed to a worker at once in the batch mode (results are written block by block, in order)
+#define JOB_BLOCK 256
+// Number of slots in the pattern cache of a batch worker (a power of 2; the cache is emptied when it is half full)
+#define CACHE_SLOTS 1024
+
+// Growable character buffer, used to print the results of a block of jobs before they are written out
+typedef struct OutputBuffer
+{
+    char *data;
+    size_t length, capacity;
+} OutputBuffer;
+
+// Cache of compiled KMP matchers, keyed by the pattern (open addressing)
+typedef struct MatcherCache
+{
+    Matcher *slots[CACHE_SLOTS];
+    unsigned long long hashes[CACHE_SLOTS];
+    int count;
+    long long hits, misses;
+} MatcherCache;
+
+// State shared by the batch workers: jobs are the lines of the (mapped) jobs file
+typedef struct BatchState
+{
+    Tokenizer file;
+    size_t *line_starts; // line k is file.text[line_starts[k] .. line_starts[k + 1] - 1]
+    int num_jobs, num_blocks;
+    int next_block; // next block to be claimed by a worker
+    OutputBuffer *outputs; // outputs[b] holds the results of block b
+    int *done; // done[b] is 1 when block b is complete
+    double *latencies; // latency of every job (in seconds)
+    long long *totals; // integers processed, pattern cache hits and pattern cache misses (summed over the workers)
+    pthread_mutex_t lock;
+    pthread_cond_t block_done;
+} BatchState;
+
+// Function to append 'length' characters to an output buffer
+void buffer_append(OutputBuffer *buffer, const char *data, size_t length)
+{
+    if (buffer -> length + length > buffer -> capacity)
+    {
+        buffer -> capacity = 2 * (buffer -> length + length) + 256;
+        buffer -> data = (char *) realloc(buffer -> data, buffer -> capacity);
+    }
+    memcpy(buffer -> data + buffer -> length, data, length);
+    buffer -> length += length;
+}
+
+// Function to print a chunk list into an output buffer (in the same format as 'traverse_chunk_LL')
+void buffer_print_chunks(OutputBuffer *buffer, Chunk *node)
+{
+    char text[32];
+    for (; node != NULL; node = node -> next)
+    {
+        for (int i = 0; i < node -> count; i++)
+        {
+            int length = sprintf(text, "%s%d", (i == 0) ? "-->(" : ",", node -> arr[i]);
+            buffer_append(buffer, text, length);
+        }
+        buffer_append(buffer, ")", 1);
+    }
+    buffer_append(buffer, "\n", 1);
+}
+
+// Function to return the compiled matcher of a (non-empty) pattern from the cache, building it on a miss
+Matcher* cache_matcher(MatcherCache *cache, Node *pattern)
+{
+    unsigned long long hash = 1469598103934665603ULL; // FNV-1a over the integers of the pattern
+    int length = 0;
+    for (Node *node = pattern; node != NULL; node = node -> next)
+    {
+        hash = (hash ^ (unsigned) node -> val) * 1099511628211ULL;
+        length++;
+    }
+    int slot = (int) (hash & (CACHE_SLOTS - 1));
+    while (cache -> slots[slot] != NULL)
+    {
+        Matcher *matcher = cache -> slots[slot];
+        if (cache -> hashes[slot] == hash && matcher -> length == length)
+        {
+            int k = 0;
+            Node *node = pattern;
+            while (node != NULL && node -> val == matcher -> pattern[k])
+            {
+                node = node -> next;
+                k++;
+            }
+            if (node == NULL)
+            {
+                cache -> hits += 1;
+                return matcher;
+            }
+        }
+        slot = (slot + 1) & (CACHE_SLOTS - 1);
+    }
+
+    cache -> misses += 1;
+    if (2 * (cache -> count + 1) > CACHE_SLOTS)
+    {
+        // Too many distinct patterns, so start afresh
+        for (int k = 0; k < CACHE_SLOTS; k++)
+        {
+            if (cache -> slots[k] != NULL)
+            {
+                free_matcher(cache -> slots[k]);
+                cache -> slots[k] = NULL;
+            }
+        }
+        cache -> count = 0;
+        slot = (int) (hash & (CACHE_SLOTS - 1));
+    }
+    cache -> slots[slot] = create_matcher(pattern);
+    cache -> hashes[slot] = hash;
+    cache -> count += 1;
+    return cache -> slots[slot];
+}
+
+// Function to run one job ("sequence pattern text", e.g. "1,2,3,$ 2,$ 9,$") and print its result (or error) into 'output'.
+// Returns the number of integers in the sequence
+long long run_job(const char *line, size_t length, MatcherCache *cache, OutputBuffer *output)
+{
+    Tokenizer tok;
+    tokenizer_init(&tok, line, length);
+    ChunkWriter writer = {NULL, NULL, NULL};
+    Node *pattern = NULL, *text = NULL;
+    long long elements = 0;
+    if (parse_sequence(&tok, &writer) && parse_list(&tok, &pattern) && parse_list(&tok, &text))
+    {
+        Chunk *result;
+        if (pattern == NULL)
+        {
+            result = corner_case(writer.head, text);
+        }
+        else
+        {
+            result = replace_with_matcher(writer.head, cache_matcher(cache, pattern), text);
+        }
+        buffer_print_chunks(output, result);
+        free_chunk_LL(result);
+    }
+    else
+    {
+        char message[128];
+        int message_length = snprintf(message, sizeof(message), "Invalid job: %s at character %zu\n", tok.error, tok.error_pos + 1);
+        buffer_append(output, message, message_length);
+    }
+    for (Chunk *node = writer.head; node != NULL; node = node -> next)
+    {
+        elements += node -> count;
+    }
+    free_chunk_LL(writer.head);
+    free_LL(pattern);
+    free_LL(text);
+    return elements;
+}
+
+// Batch worker: claims blocks of jobs until none are left, with its own node pools and pattern cache (reused by all its jobs)
+void* batch_worker(void *arg)
+{
+    BatchState *state = (BatchState *) arg;
+    Pool chunks = {chunk_pool.object_size, chunk_pool.alignment, NULL, NULL, 0, NULL, 0, 0, 0, 0, 0};
+    Pool nodes = {node_pool.object_size, node_pool.alignment, NULL, NULL, 0, NULL, 0, 0, 0, 0, 0};
+    thread_chunk_pool = &chunks;
+    thread_node_pool = &nodes;
+    MatcherCache *cache = (MatcherCache *) calloc(1, sizeof(MatcherCache));
+    long long elements = 0;
+
+    while (1)
+    {
+        pthread_mutex_lock(&state -> lock);
+        int block = state -> next_block++;
+        pthread_mutex_unlock(&state -> lock);
+        if (block >= state -> num_blocks)
+        {
+            break;
+        }
+
+        OutputBuffer *output = &state -> outputs[block];
+        int last = (block + 1) * JOB_BLOCK;
+        for (int job = block * JOB_BLOCK; job < last && job < state -> num_jobs; job++)
+        {
+            struct timespec begin, end;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            size_t start = state -> line_starts[job];
+            elements += run_job(state -> file.text + start, state -> line_starts[job + 1] - start, cache, output);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            state -> latencies[job] = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+        }
+
+        pthread_mutex_lock(&state -> lock);
+        state -> done[block] = 1;
+        pthread_cond_signal(&state -> block_done);
+        pthread_mutex_unlock(&state -> lock);
+    }
+
+    for (int k = 0; k < CACHE_SLOTS; k++)
+    {
+        if (cache -> slots[k] != NULL)
+        {
+            free_matcher(cache -> slots[k]);
+        }
+    }
+
+    // Hand the pools (and their statistics) over to the global pools, and record the statistics of this worker
+    pthread_mutex_lock(&state -> lock);
+    pool_absorb(&chunk_pool, &chunks);
+    pool_absorb(&node_pool, &nodes);
+    state -> totals[0] += elements;
+    state -> totals[1] += cache -> hits;
+    state -> totals[2] += cache -> misses;
+    pthread_mutex_unlock(&state -> lock);
+    free(cache);
+    thread_chunk_pool = &chunk_pool;
+    thread_node_pool = &node_pool;
+    return NULL;
+}
+
+// Comparison function for qsort over doubles
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Function to run every job (one per line) of a jobs file with 'num_threads' worker threads, and write the results to 'out' in the
+// order of the jobs (one line per job). Throughput and latency percentiles are reported on stderr. Returns 1 if the file can't be read.
+int run_batch(char *file_name, int num_threads, FILE *out)
+{
+    BatchState state;
+    if (!tokenizer_open_file(&state.file, file_name))
+    {
+        printf("Jobs file could not be opened.\n");
+        return 1;
+    }
+
+    // Find the lines of the file (blank lines are skipped)
+    int capacity = 1024;
+    state.num_jobs = 0;
+    state.line_starts = (size_t *) malloc((capacity + 1) * sizeof(size_t));
+    size_t pos = 0;
+    while (pos < state.file.length)
+    {
+        const char *newline = memchr(state.file.text + pos, '\n', state.file.length - pos);
+        size_t end = (newline != NULL) ? (size_t) (newline - state.file.text) : state.file.length;
+        size_t k = pos;
+        while (k < end && (state.file.text[k] == ' ' || state.file.text[k] == '\t' || state.file.text[k] == '\r'))
+        {
+            k++;
+        }
+        if (k < end)
+        {
+            if (state.num_jobs == capacity)
+            {
+                capacity *= 2;
+                state.line_starts = (size_t *) realloc(state.line_starts, (capacity + 1) * sizeof(size_t));
+            }
+            state.line_starts[state.num_jobs++] = pos;
+        }
+        pos = end + 1;
+    }
+    // Jobs end at the start of the next job (parsing a job stops at the end of its third list anyway)
+    state.line_starts[state.num_jobs] = state.file.length;
+
+    state.num_blocks = (state.num_jobs + JOB_BLOCK - 1) / JOB_BLOCK;
+    state.next_block = 0;
+    state.outputs = (OutputBuffer *) calloc(state.num_blocks + 1, sizeof(OutputBuffer));
+    state.done = (int *) calloc(state.num_blocks + 1, sizeof(int));
+    state.latencies = (double *) malloc((state.num_jobs + 1) * sizeof(double));
+    long long totals[3] = {0, 0, 0}; // integers processed, pattern cache hits, pattern cache misses
+    state.totals = totals;
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.block_done, NULL);
+
+    if (num_threads < 1)
+    {
+        num_threads = 1;
+    }
+    if (num_threads > MAX_THREADS)
+    {
+        num_threads = MAX_THREADS;
+    }
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    pthread_t threads[MAX_THREADS];
+    for (int t = 0; t < num_threads; t++)
+    {
+        pthread_create(&threads[t], NULL, batch_worker, &state);
+    }
+
+    // Write the blocks in order as soon as they are complete
+    for (int block = 0; block < state.num_blocks; block++)
+    {
+        pthread_mutex_lock(&state.lock);
+        while (!state.done[block])
+        {
+            pthread_cond_wait(&state.block_done, &state.lock);
+        }
+        pthread_mutex_unlock(&state.lock);
+        fwrite(state.outputs[block].data, 1, state.outputs[block].length, out);
+        free(state.outputs[block].data);
+    }
+    for (int t = 0; t < num_threads; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    // Report throughput and latency percentiles
+    qsort(state.latencies, state.num_jobs, sizeof(double), compare_doubles);
+    double percentiles[4] = {0.5, 0.9, 0.99, 1.0};
+    fprintf(stderr, "%d jobs (%lld integers) with %d threads in %.3f s: %.0f jobs/s, %.1f million integers/s\n", state.num_jobs, totals[0], num_threads,
+        seconds, (seconds > 0) ? state.num_jobs / seconds : 0.0, (seconds > 0) ? totals[0] / seconds / 1e6 : 0.0);
+    fprintf(stderr, "Job latency (us):");
+    for (int k = 0; k < 4 && state.num_jobs > 0; k++)
+    {
+        int rank = (int) (percentiles[k] * (state.num_jobs - 1));
+        fprintf(stderr, " %s %.1f", (k == 0) ? "p50" : (k == 1) ? "p90" : (k == 2) ? "p99" : "max", state.latencies[rank] * 1e6);
+    }
+    fprintf(stderr, "\nPattern cache: %lld hits, %lld misses\n", totals[1], totals[2]);
+    print_pool_stats(stderr);
+
+    pthread_mutex_destroy(&state.lock);
+    pthread_cond_destroy(&state.block_done);
+    free(state.outputs);
+    free(state.done);
+    free(state.latencies);
+    free(state.line_starts);
+    tokenizer_close(&state.file);
+    return 0;
+}
+
+// Function to replace all occurrences of 'pattern' with 'text' in a sequence of any length, read from 'in' in blocks of BLOCK_SIZE characters.
+// The input has the same format as the interactive sequence ("1,2,3,$", whitespace is ignored). Integers are parsed incrementally across blocks,
+// the only carry-over between blocks is the partial KMP match (atmost m - 1 integers, which are a prefix of the pattern),
+// and the replaced sequence is printed to 'out' chunk by chunk. So the memory used is O(m + BLOCK_SIZE), irrespective of the sequence length.
+// Returns 0 on success, and 1 if the input is malformed (the output written till then is valid).
+int stream_replace(FILE *in, FILE *out, Node *pattern, Node *text)
+{
+    char *block = (char *) malloc(BLOCK_SIZE);
+    Matcher *matcher = (pattern != NULL) ? create_matcher(pattern) : NULL;
+    ChunkWriter writer = {NULL, NULL, out};
+    int q = 0;
+
+    // Empty pattern matches only at the beginning of the sequence (same as 'corner_case')
+    if (pattern == NULL)
+    {
+        writer_append_LL(&writer, text);
+    }
+
+    // State of the incremental integer parser
+    long long num = 0;
+    int negative = 0, digits = 0, done = 0, error = 0;
+    int ended = 0; // 1 once whitespace follows the digits of an integer (which must then be followed by ',', as in 'tokenizer_int')
+    long long offset = 0; // number of characters read so far, used for error messages
+    Tokenizer tok; // records the first error (the input is parsed here block by block, so only its error fields are used)
+    tokenizer_init(&tok, "", 0);
+
+    size_t length;
+    while (!done && !error && (length = fread(block, 1, BLOCK_SIZE, in)) > 0)
+    {
+        for (size_t i = 0; i < length && !done && !error; i++)
+        {
+            char c = block[i];
+            if (ended && c != ',' && !isspace((unsigned char) c))
+            {
+                // Whitespace can separate an integer from ',', but not split it
+                tok.pos = (size_t) offset + i;
+                error = !tokenizer_fail(&tok, "unexpected character");
+            }
+            else if (c >= '0' && c <= '9')
+            {
+                num = num * 10 + (c - '0');
+                digits++;
+                if (num > (long long) INT_MAX + 1)
+                {
+                    tok.pos = (size_t) offset + i;
+                    error = !tokenizer_fail(&tok, "integer out of range");
+                }
+            }
+            else if (c == '-' && digits == 0 && !negative)
+            {
+                negative = 1;
+            }
+            else if (c == ',')
+            {
+                if (digits == 0 || (!negative && num > INT_MAX))
+                {
+                    tok.pos = (size_t) offset + i;
+                    error = !tokenizer_fail(&tok, "expected an integer");
+                    break;
+                }
+                int val = (int) (negative ? -num : num);
+                if (matcher != NULL)
+                {
+                    kmp_step(matcher, &q, val, text, &writer);
                 }
                 else
                 {
-                    node2 -> next = new_node;
-                    node2 = node2 -> next;
+                    writer_append(&writer, val);
+                }
+                num = 0;
+                negative = digits = ended = 0;
+            }
+            else if (c == '$')
+            {
+                done = 1;
+            }
+            else if (!isspace((unsigned char) c))
+            {
+                tok.pos = (size_t) offset + i;
+                error = !tokenizer_fail(&tok, "unexpected character");
+            }
+            else if (digits > 0)
+            {
+                ended = 1;
+            }
+            else if (negative)
+            {
+                // '-' must be followed directly by the digits (the error is reported at the '-', which is the previous character)
+                tok.pos = (size_t) offset + i - 1;
+                error = !tokenizer_fail(&tok, "expected an integer");
+            }
+        }
+        offset += (long long) length;
+    }
+
+    // The input ended without the terminating '$' (or in the middle of an integer)
+    tok.pos = (size_t) offset;
+    if (!error && (digits > 0 || negative))
+    {
+        error = !tokenizer_fail(&tok, "last integer is not followed by ','");
+    }
+    else if (!error && !done)
+    {
+        error = !tokenizer_fail(&tok, "unexpected end of input (missing '$')");
+    }
+    tokenizer_report(&tok, "Invalid sequence", stderr);
+
+    // The sequence ended in the middle of a partial match, so those integers are not replaced
+    if (matcher != NULL)
+    {
+        writer_append_array(&writer, matcher -> pattern, q);
+        free_matcher(matcher);
+    }
+    writer_flush(&writer);
+    fprintf(out, "\n");
+
+    free_chunk_LL(writer.tail);
+    free(block);
+    return error;
+}
+
+// Function to read rewrite rules from a file, one rule per line as "pattern text" (e.g. "1,2,$ 7,$"), and return the number of rules read
+// Empty patterns are not allowed in the multi-pattern mode, so such rules are skipped
+int input_rules(char *file_name, Rule **rules)
+{
+    // The whole file is mapped into memory and parsed in place
+    Tokenizer tok;
+    if (!tokenizer_open_file(&tok, file_name))
+    {
+        printf("Rules file could not be opened.\n");
+        *rules = NULL;
+        return 0;
+    }
+
+    int num_rules = 0, capacity = 16;
+    *rules = (Rule *) malloc(capacity * sizeof(Rule));
+    while (tokenizer_peek(&tok) != -1)
+    {
+        Node *pattern, *text;
+        if (!parse_list(&tok, &pattern) || !parse_list(&tok, &text))
+        {
+            tokenizer_report(&tok, "Invalid rules file", stderr);
+            exit(1);
+        }
+        if (pattern == NULL)
+        {
+            printf("Skipping rule %d: empty pattern.\n", num_rules + 1);
+            free_LL(text);
+            continue;
+        }
+        if (num_rules == capacity)
+        {
+            capacity *= 2;
+            *rules = (Rule *) realloc(*rules, capacity * sizeof(Rule));
+        }
+        Rule *rule = &(*rules)[num_rules];
+        rule -> pattern = pattern;
+        rule -> text = text;
+        rule -> length = 0;
+        for (Node *node = pattern; node != NULL; node = node -> next)
+        {
+            rule -> length += 1;
+        }
+        num_rules++;
+    }
+    tokenizer_close(&tok);
+    return num_rules;
+}
+
+// Test harness: the replacement strategies are checked against a simple array-based reference (--fuzz) and timed (--bench)
+// on random and adversarial sequences
+
+// Kinds of test sequences
+#define GEN_RANDOM 0 // random integers from a small alphabet, random pattern (sometimes empty, or longer than the sequence)
+#define GEN_PERIODIC 1 // one short unit repeated, pattern made of the same unit (many overlapping candidate matches)
+#define GEN_NEAR_MISS 2 // mostly 0s, pattern 0,0,...,0,1 (long partial matches which almost never complete)
+#define NUM_GENERATORS 3
+
+// Replacement strategies
+#define STRATEGY_KMP 0 // replace_all_patterns
+#define STRATEGY_IN_PLACE 1 // replace_in_place
+#define STRATEGY_PARALLEL 2 // replace_all_patterns_parallel
+#define STRATEGY_ROPE 3 // rope_replace_all
+#define STRATEGY_RULES 4 // replace_all_rules with a single rule
+#define STRATEGY_STREAM 5 // stream_replace (only used by the fuzzer, it works on files)
+#define NUM_STRATEGIES 6
+
+char *generator_names[NUM_GENERATORS] = {"random", "periodic", "near-miss"};
+char *strategy_names[NUM_STRATEGIES] = {"kmp", "in-place", "parallel", "rope", "aho-corasick", "stream"};
+
+// Function to generate a test case of the given kind: the sequence values[0..n-1], the pattern pattern[0..*m-1] (atmost 8 integers)
+// and the replacement text text[0..*t-1] (atmost 4 integers)
+void generate_case(int kind, int n, int *values, int *pattern, int *m, int *text, int *t)
+{
+    if (kind == GEN_RANDOM)
+    {
+        int alphabet = 1 + rand() % 4;
+        for (int k = 0; k < n; k++)
+        {
+            values[k] = rand() % alphabet;
+        }
+        *m = (rand() % 8 == 0) ? 0 : 1 + rand() % 6;
+        if (n > 0 && *m > 0 && rand() % 2 == 0)
+        {
+            // Take the pattern from the sequence, so that it occurs atleast once (if it fits)
+            int start = rand() % n;
+            for (int k = 0; k < *m; k++)
+            {
+                pattern[k] = values[(start + k) % n];
+            }
+        }
+        else
+        {
+            for (int k = 0; k < *m; k++)
+            {
+                pattern[k] = rand() % alphabet;
+            }
+        }
+    }
+    else if (kind == GEN_PERIODIC)
+    {
+        int unit[3], length = 1 + rand() % 3;
+        for (int k = 0; k < length; k++)
+        {
+            unit[k] = rand() % 2;
+        }
+        for (int k = 0; k < n; k++)
+        {
+            values[k] = unit[k % length];
+        }
+        int shift = rand() % length;
+        *m = 1 + rand() % (2 * length + 1);
+        for (int k = 0; k < *m; k++)
+        {
+            pattern[k] = unit[(shift + k) % length];
+        }
+    }
+    else
+    {
+        for (int k = 0; k < n; k++)
+        {
+            values[k] = (rand() % 64 == 0) ? 1 : 0;
+        }
+        *m = 2 + rand() % 7;
+        for (int k = 0; k < *m; k++)
+        {
+            pattern[k] = (k == *m - 1) ? 1 : 0;
+        }
+    }
+    *t = rand() % 5;
+    for (int k = 0; k < *t; k++)
+    {
+        text[k] = 7 + rand() % 3;
+    }
+}
+
+// Reference replacement on arrays: left to right, non-overlapping, the empty pattern matches only at the beginning.
+// 'out' must have room for n * (t + 1) + t integers. Returns the number of integers in 'out'
+int reference_replace(int *values, int n, int *pattern, int m, int *text, int t, int *out)
+{
+    int length = 0, k = 0;
+    if (m == 0)
+    {
+        memcpy(out, text, t * sizeof(int));
+        memcpy(out + t, values, n * sizeof(int));
+        return t + n;
+    }
+    while (k < n)
+    {
+        if (k + m <= n && memcmp(values + k, pattern, m * sizeof(int)) == 0)
+        {
+            memcpy(out + length, text, t * sizeof(int));
+            length += t;
+            k += m;
+        }
+        else
+        {
+            out[length++] = values[k++];
+        }
+    }
+    return length;
+}
+
+// Maximum number of rules (and integers in a rule pattern) of a multi-rule test case
+#define MAX_FUZZ_RULES 5
+#define MAX_RULE_LENGTH 6
+
+// Function to generate a multi-rule test case: *num_rules rules (patterns[r][0..lengths[r]-1] -> texts[r][0..text_lengths[r]-1])
+// and the sequence values[0..n-1]. Every rule after the first is derived from an earlier one, so that the rules conflict:
+// a duplicate pattern, a prefix or an extension of it (same start, different length), or a suffix of it followed by
+// other integers (overlapping matches). The sequence is often glued from the patterns, so that the conflicts actually occur
+void generate_rules(int n, int *values, int patterns[][MAX_RULE_LENGTH], int *lengths, int texts[][4], int *text_lengths, int *num_rules)
+{
+    int alphabet = 1 + rand() % 3;
+    *num_rules = 2 + rand() % (MAX_FUZZ_RULES - 1);
+    for (int r = 0; r < *num_rules; r++)
+    {
+        int from = (r == 0) ? -1 : rand() % r;
+        int kind = (from == -1) ? 3 : rand() % 4;
+        if (kind == 0)
+        {
+            // Duplicate pattern (the earlier rule must win)
+            lengths[r] = lengths[from];
+            memcpy(patterns[r], patterns[from], lengths[r] * sizeof(int));
+        }
+        else if (kind == 1)
+        {
+            // Prefix or extension: both patterns match at the same place, with different lengths
+            lengths[r] = 1 + rand() % MAX_RULE_LENGTH;
+            for (int k = 0; k < lengths[r]; k++)
+            {
+                patterns[r][k] = (k < lengths[from]) ? patterns[from][k] : rand() % alphabet;
+            }
+        }
+        else if (kind == 2)
+        {
+            // A suffix of the earlier pattern followed by other integers: matches of the two patterns overlap
+            int shift = rand() % lengths[from];
+            lengths[r] = 1 + rand() % MAX_RULE_LENGTH;
+            for (int k = 0; k < lengths[r]; k++)
+            {
+                patterns[r][k] = (shift + k < lengths[from]) ? patterns[from][shift + k] : rand() % alphabet;
+            }
+        }
+        else
+        {
+            lengths[r] = 1 + rand() % MAX_RULE_LENGTH;
+            for (int k = 0; k < lengths[r]; k++)
+            {
+                patterns[r][k] = rand() % alphabet;
+            }
+        }
+        // Texts differ between rules, so that the output shows which rule was applied
+        text_lengths[r] = rand() % 4;
+        for (int k = 0; k < text_lengths[r]; k++)
+        {
+            texts[r][k] = 10 * (r + 1) + k;
+        }
+    }
+
+    int k = 0;
+    int glued = rand() % 2;
+    while (k < n)
+    {
+        if (glued && rand() % 4 != 0)
+        {
+            // Copy (a part of) a random pattern, possibly cut short by the end of the sequence
+            int r = rand() % *num_rules;
+            int start = (rand() % 3 == 0) ? rand() % lengths[r] : 0;
+            for (int j = start; j < lengths[r] && k < n; j++)
+            {
+                values[k++] = patterns[r][j];
+            }
+        }
+        else
+        {
+            values[k++] = rand() % alphabet;
+        }
+    }
+}
+
+// Reference for 'replace_all_rules' on arrays: at every position (left to right) the longest matching pattern is replaced,
+// the earliest rule among identical patterns; the replaced integers are skipped. 'out' must have room for 3 * n integers.
+// Returns the number of integers in 'out'
+int reference_replace_rules(int *values, int n, int patterns[][MAX_RULE_LENGTH], int *lengths, int texts[][4], int *text_lengths,
+    int num_rules, int *out)
+{
+    int length = 0, k = 0;
+    while (k < n)
+    {
+        int best = -1;
+        for (int r = 0; r < num_rules; r++)
+        {
+            if (k + lengths[r] <= n && memcmp(values + k, patterns[r], lengths[r] * sizeof(int)) == 0
+                && (best == -1 || lengths[r] > lengths[best]))
+            {
+                best = r;
+            }
+        }
+        if (best != -1)
+        {
+            memcpy(out + length, texts[best], text_lengths[best] * sizeof(int));
+            length += text_lengths[best];
+            k += lengths[best];
+        }
+        else
+        {
+            out[length++] = values[k++];
+        }
+    }
+    return length;
+}
+
+// Function to create a normal linked list from an array
+Node* LL_from_array(int *values, int count)
+{
+    Node *head = NULL, *node = NULL;
+    for (int k = 0; k < count; k++)
+    {
+        Node *new_node = create_node();
+        new_node -> val = values[k];
+        if (head == NULL)
+        {
+            head = node = new_node;
+        }
+        else
+        {
+            node -> next = new_node;
+            node = node -> next;
+        }
+    }
+    return head;
+}
+
+// Function to create a chunk list from an array
+Chunk* chunks_from_array(int *values, int count)
+{
+    ChunkWriter writer = {NULL, NULL, NULL};
+    writer_append_array(&writer, values, count);
+    return writer.head;
+}
+
+// Function to read the integers printed by 'stream_replace' ("-->(1,2)-->(3)") back from a file into 'out'; returns their number
+int read_printed_chunks(FILE *fp, int *out)
+{
+    int count = 0, c;
+    while ((c = fgetc(fp)) != EOF)
+    {
+        if (c == '(' || c == ',')
+        {
+            if (fscanf(fp, "%d", &out[count]) == 1)
+            {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// Function to run one strategy on a sequence and return the replacement sequence (the input sequence is not modified).
+// Only the call to the strategy itself is measured: its time is added to '*seconds' and its node allocations to '*allocations'
+// (rope nodes are allocated with malloc, and are not counted)
+Chunk* run_strategy(int strategy, Chunk *sequence, Node *pattern, Node *text, int threads, double *seconds, long long *allocations)
+{
+    Chunk *result = NULL;
+    struct timespec begin, end;
+    long long before = 0, after = 0; // pool allocations
+    if (strategy == STRATEGY_IN_PLACE)
+    {
+        // Work on a copy, since the sequence is modified
+        ChunkWriter copy = {NULL, NULL, NULL};
+        for (Chunk *node = sequence; node != NULL; node = node -> next)
+        {
+            writer_append_array(&copy, node -> arr, node -> count);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        before = chunk_pool.allocations + node_pool.allocations;
+        result = replace_in_place(copy.head, pattern, text);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        after = chunk_pool.allocations + node_pool.allocations;
+    }
+    else if (strategy == STRATEGY_ROPE)
+    {
+        Rope *rope = rope_from_chunks(sequence);
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        before = chunk_pool.allocations + node_pool.allocations;
+        Rope *replaced = rope_replace_all(rope, pattern, text);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        after = chunk_pool.allocations + node_pool.allocations;
+        result = rope_to_chunks(replaced);
+        rope_release(rope);
+        rope_release(replaced);
+    }
+    else if (strategy == STRATEGY_RULES && pattern != NULL)
+    {
+        Rule rule = {pattern, text, 0};
+        for (Node *node = pattern; node != NULL; node = node -> next)
+        {
+            rule.length += 1;
+        }
+        Automaton *ac = create_automaton(&rule, 1);
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        before = chunk_pool.allocations + node_pool.allocations;
+        result = replace_all_rules(sequence, ac);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        after = chunk_pool.allocations + node_pool.allocations;
+        free_automaton(ac);
+    }
+    else if (strategy == STRATEGY_STREAM)
+    {
+        // Print the sequence to a temporary file, stream it through, and read the result back
+        FILE *in = tmpfile(), *out = tmpfile();
+        for (Chunk *node = sequence; node != NULL; node = node -> next)
+        {
+            for (int k = 0; k < node -> count; k++)
+            {
+                fprintf(in, "%d,", node -> arr[k]);
+            }
+        }
+        fprintf(in, "$");
+        rewind(in);
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        before = chunk_pool.allocations + node_pool.allocations;
+        stream_replace(in, out, pattern, text);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        after = chunk_pool.allocations + node_pool.allocations;
+        rewind(out);
+        long long n = 0, t = 0;
+        for (Chunk *node = sequence; node != NULL; node = node -> next)
+        {
+            n += node -> count;
+        }
+        for (Node *node = text; node != NULL; node = node -> next)
+        {
+            t++;
+        }
+        int *values = (int *) malloc((n * (t + 1) + t + 1) * sizeof(int));
+        result = chunks_from_array(values, read_printed_chunks(out, values));
+        free(values);
+        fclose(in);
+        fclose(out);
+    }
+    else
+    {
+        // The KMP strategy (and the rules strategy for the empty pattern, which the automaton doesn't support)
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        before = chunk_pool.allocations + node_pool.allocations;
+        if (strategy == STRATEGY_PARALLEL)
+        {
+            result = replace_all_patterns_parallel(sequence, pattern, text, threads);
+        }
+        else
+        {
+            result = replace_all_patterns(sequence, pattern, text);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        after = chunk_pool.allocations + node_pool.allocations;
+    }
+    *seconds += (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    *allocations += after - before;
+    return result;
+}
+
+// Function to compare a chunk list with an array; also checks that no chunk is empty or overfull. Returns 1 if they are equal
+int check_chunks(Chunk *node, int *expected, int length)
+{
+    int k = 0;
+    for (; node != NULL; node = node -> next)
+    {
+        if (node -> count < 1 || node -> count > CHUNK_CAPACITY || k + node -> count > length)
+        {
+            return 0;
+        }
+        if (memcmp(node -> arr, expected + k, node -> count * sizeof(int)) != 0)
+        {
+            return 0;
+        }
+        k += node -> count;
+    }
+    return k == length;
+}
+
+// Function to print an array (used to report a failing test case)
+void print_array(char *name, int *values, int count)
+{
+    printf("%s:", name);
+    for (int k = 0; k < count; k++)
+    {
+        printf("%s%d", (k == 0) ? " " : ",", values[k]);
+    }
+    printf(" (%d integers)\n", count);
+}
+
+// Function to check the query API on a sequence: 'find_matches', 'count_matches' and the match index must all report the
+// occurrences of the pattern found by comparing it at every position of 'values'. Returns 1 if they agree
+int check_queries(Chunk *sequence, Node *pattern_LL, int *values, int n, int *pattern, int m)
+{
+    long long *expected = (long long *) malloc((n + 1) * sizeof(long long));
+    long long *positions = (long long *) malloc((n + 1) * sizeof(long long));
+    long long count = 0;
+    for (int k = 0; k + m <= n; k++)
+    {
+        if (m > 0 && memcmp(values + k, pattern, m * sizeof(int)) == 0)
+        {
+            expected[count++] = k;
+        }
+    }
+    if (m == 0)
+    {
+        expected[count++] = 0; // the empty pattern occurs only at position 0
+    }
+
+    int ok = (count_matches(sequence, pattern_LL) == count);
+    ok = ok && (find_matches(sequence, pattern_LL, positions, n + 1) == count);
+    ok = ok && memcmp(positions, expected, count * sizeof(long long)) == 0;
+    // A limit smaller than the number of occurrences returns the first ones
+    ok = ok && (count == 0 || find_matches(sequence, pattern_LL, positions, 1) == 1);
+    ok = ok && (count == 0 || positions[0] == expected[0]);
+
+    MatchIndex *index = build_match_index(sequence);
+    ok = ok && (index_count_matches(index, pattern_LL) == count);
+    ok = ok && (index_find_matches(index, pattern_LL, positions, n + 1) == count);
+    ok = ok && memcmp(positions, expected, count * sizeof(long long)) == 0;
+    free_match_index(index);
+    free(expected);
+    free(positions);
+    return ok;
+}
+
+// Function to check 'replace_all_rules' with several conflicting rules against the array reference.
+// Returns 1 if they agree
+int check_rules(int *values, int n, int patterns[][MAX_RULE_LENGTH], int *lengths, int texts[][4], int *text_lengths, int num_rules,
+    int *expected, int length)
+{
+    Rule rules[MAX_FUZZ_RULES];
+    for (int r = 0; r < num_rules; r++)
+    {
+        rules[r].pattern = LL_from_array(patterns[r], lengths[r]);
+        rules[r].text = LL_from_array(texts[r], text_lengths[r]);
+        rules[r].length = lengths[r];
+    }
+    Chunk *sequence = chunks_from_array(values, n);
+    Automaton *ac = create_automaton(rules, num_rules);
+    Chunk *result = replace_all_rules(sequence, ac);
+    int ok = check_chunks(result, expected, length);
+    free_automaton(ac);
+    free_chunk_LL(result);
+    free_chunk_LL(sequence);
+    for (int r = 0; r < num_rules; r++)
+    {
+        free_LL(rules[r].pattern);
+        free_LL(rules[r].text);
+    }
+    return ok;
+}
+
+// Function to check every strategy (and 'match', the queries and multi-rule replacement) against the references on 'cases' random test cases of every kind.
+// Returns 0 if all of them pass; the first failing case is printed
+int fuzz(int cases, unsigned seed)
+{
+    srand(seed);
+    int max_n = 300;
+    int *values = (int *) malloc(max_n * sizeof(int));
+    int *expected = (int *) malloc((max_n * 5 + 4) * sizeof(int));
+    int pattern[8], text[4], m, t;
+
+    for (int c = 0; c < cases; c++)
+    {
+        for (int kind = 0; kind < NUM_GENERATORS; kind++)
+        {
+            // Sizes are biased towards small sequences, where boundary cases (e.g. pattern longer than the sequence) are common
+            int n = (rand() % 4 == 0) ? rand() % max_n : rand() % 16;
+            generate_case(kind, n, values, pattern, &m, text, &t);
+            int length = reference_replace(values, n, pattern, m, text, t, expected);
+
+            Chunk *sequence = chunks_from_array(values, n);
+            Node *pattern_LL = LL_from_array(pattern, m);
+            Node *text_LL = LL_from_array(text, t);
+            double seconds = 0;
+            long long allocations = 0;
+            int failed = -1;
+            for (int strategy = 0; strategy < NUM_STRATEGIES && failed == -1; strategy++)
+            {
+                Chunk *result = run_strategy(strategy, sequence, pattern_LL, text_LL, 1 + rand() % 4, &seconds, &allocations);
+                if (!check_chunks(result, expected, length))
+                {
+                    failed = strategy;
                 }
+                free_chunk_LL(result);
+            }
 
+            // 'match' at every position must agree with a direct comparison
+            Chunk *node = sequence;
+            int index = 0;
+            for (int k = 0; k < n && failed == -1; k++)
+            {
+                int found = (k + m <= n && memcmp(values + k, pattern, m * sizeof(int)) == 0);
+                if (match(node, index, pattern, m) != found)
+                {
+                    failed = NUM_STRATEGIES;
+                }
+                next_position(&node, &index);
             }
-            else
+
+            // The query API (scan and suffix array index) must find the same positions as a direct comparison
+            if (failed == -1 && !check_queries(sequence, pattern_LL, values, n, pattern, m))
             {
-                node2->arr[index2] = node1->arr[index1];
+                failed = NUM_STRATEGIES + 1;
             }
-            index2 += 1;
-            if (index2 == 8)
+
+            free_chunk_LL(sequence);
+            free_LL(pattern_LL);
+            free_LL(text_LL);
+            if (failed != -1)
             {
-                index2 = 0;
+                printf("Case %d (%s) failed for %s\n", c, generator_names[kind],
+                    (failed < NUM_STRATEGIES) ? strategy_names[failed] : (failed == NUM_STRATEGIES) ? "match" : "find_matches");
+                print_array("Sequence", values, n);
+                print_array("Pattern", pattern, m);
+                print_array("Text", text, t);
+                print_array("Expected", expected, length);
+                free(values);
+                free(expected);
+                return 1;
             }
-            // Increment index1 as well
-            index1 += 1;
-            if (index1 == 8)
+        }
+
+        // Several rules at once: leftmost match first, then the longest pattern, then the earliest rule
+        int n = (rand() % 4 == 0) ? rand() % max_n : rand() % 16;
+        int num_rules, lengths[MAX_FUZZ_RULES], text_lengths[MAX_FUZZ_RULES];
+        int patterns[MAX_FUZZ_RULES][MAX_RULE_LENGTH], texts[MAX_FUZZ_RULES][4];
+        generate_rules(n, values, patterns, lengths, texts, text_lengths, &num_rules);
+        int length = reference_replace_rules(values, n, patterns, lengths, texts, text_lengths, num_rules, expected);
+        if (!check_rules(values, n, patterns, lengths, texts, text_lengths, num_rules, expected, length))
+        {
+            printf("Case %d (%d rules) failed for %s\n", c, num_rules, strategy_names[STRATEGY_RULES]);
+            print_array("Sequence", values, n);
+            for (int r = 0; r < num_rules; r++)
             {
-                node1 = node1 -> next;
-                index1 = 0;
-                node_count += 1;
+                char name[32];
+                snprintf(name, sizeof(name), "Rule %d pattern", r + 1);
+                print_array(name, patterns[r], lengths[r]);
+                snprintf(name, sizeof(name), "Rule %d text", r + 1);
+                print_array(name, texts[r], text_lengths[r]);
             }
+            print_array("Expected", expected, length);
+            free(values);
+            free(expected);
+            return 1;
         }
     }
+    printf("All %d x %d test cases (and %d multi-rule cases) passed for every strategy.\n", cases, NUM_GENERATORS, cases);
+    free(values);
+    free(expected);
+    return 0;
+}
 
-    // Return the replacement sequence
-    return head2;
+// Function to measure the throughput (integers/s) and the allocations per run of every strategy on sequences of 'n' integers of every kind.
+// Rebuild with a different -DCHUNK_CACHE_LINES (or -DCHUNK_CAPACITY) to compare chunk sizes; 'threads' is used for the parallel strategy
+void benchmark(int n, int threads)
+{
+    srand(1);
+    int *values = (int *) malloc((n > 0 ? n : 1) * sizeof(int));
+    int pattern[8], text[4], m, t;
+    int rounds = 10;
+
+    printf("Chunk capacity: %d integers (%d bytes per chunk)\n", CHUNK_CAPACITY, (int) sizeof(Chunk));
+    printf("%-10s %-13s %14s %18s\n", "Sequence", "Strategy", "M integers/s", "Allocations/run");
+    for (int kind = 0; kind < NUM_GENERATORS; kind++)
+    {
+        // Use a non-empty pattern, so that every strategy can run
+        do
+        {
+            generate_case(kind, n, values, pattern, &m, text, &t);
+        } while (m == 0);
+        if (kind == GEN_RANDOM)
+        {
+            // A rare pattern, as in typical workloads
+            for (int k = 0; k < n; k++)
+            {
+                values[k] = rand() % 100;
+            }
+        }
+        Chunk *sequence = chunks_from_array(values, n);
+        Node *pattern_LL = LL_from_array(pattern, m);
+        Node *text_LL = LL_from_array(text, t);
+
+        for (int strategy = 0; strategy < STRATEGY_STREAM; strategy++)
+        {
+            double seconds = 0;
+            long long allocations = 0;
+            for (int r = 0; r < rounds; r++)
+            {
+                free_chunk_LL(run_strategy(strategy, sequence, pattern_LL, text_LL, threads, &seconds, &allocations));
+            }
+            printf("%-10s %-13s %14.1f %18lld\n", generator_names[kind], strategy_names[strategy],
+                (seconds > 0) ? rounds * (double) n / seconds / 1e6 : 0.0, allocations / rounds);
+        }
+
+        free_chunk_LL(sequence);
+        free_LL(pattern_LL);
+        free_LL(text_LL);
+    }
+    print_pool_stats(stdout);
+    free(values);
 }
 
-int main()
+int main(int argc, char *argv[])
 {
-    // NOTE: The case for empty pattern is still not handled 
+    // Fuzz mode: --fuzz [cases [seed]], e.g. --fuzz 10000 7 (checks every strategy against a reference implementation)
+    if (argc >= 2 && argc <= 4 && strcmp(argv[1], "--fuzz") == 0)
+    {
+        int error = fuzz((argc >= 3) ? atoi(argv[2]) : 1000, (argc == 4) ? (unsigned) atoi(argv[3]) : 1);
+        pool_destroy(&chunk_pool);
+        pool_destroy(&node_pool);
+        return error;
+    }
+
+    // Benchmark mode: --bench [n [threads]], e.g. --bench 10000000 4
+    if (argc >= 2 && argc <= 4 && strcmp(argv[1], "--bench") == 0)
+    {
+        benchmark((argc >= 3) ? atoi(argv[2]) : 1000000, (argc == 4) ? atoi(argv[3]) : 4);
+        pool_destroy(&chunk_pool);
+        pool_destroy(&node_pool);
+        return 0;
+    }
+
+    // Batch mode: --batch jobs_file [threads], e.g. --batch jobs.txt 4 (one "sequence pattern text" job per line, results in the same order)
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--batch") == 0)
+    {
+        int error = run_batch(argv[2], (argc == 4) ? atoi(argv[3]) : 4, stdout);
+        pool_destroy(&chunk_pool);
+        pool_destroy(&node_pool);
+        return error;
+    }
+
+    // Streaming mode: --stream pattern text [file], e.g. --stream 1,2,$ 9,$ input.txt (reads the sequence from stdin if no file is given)
+    if ((argc == 4 || argc == 5) && strcmp(argv[1], "--stream") == 0)
+    {
+        FILE *in = (argc == 5) ? fopen(argv[4], "r") : stdin;
+        if (in == NULL)
+        {
+            printf("Sequence file could not be opened.\n");
+            return 1;
+        }
+        Node *pattern = parse_LL(argv[2]);
+        Node *text = parse_LL(argv[3]);
+        int error = stream_replace(in, stdout, pattern, text);
+        free_LL(pattern);
+        free_LL(text);
+        pool_destroy(&chunk_pool);
+        pool_destroy(&node_pool);
+        if (in != stdin)
+        {
+            fclose(in);
+        }
+        return error;
+    }
 
     printf("\nEnter sequence S: ");
     Chunk *sequence = input_sequence();
@@ -469,6 +3327,32 @@ int main()
     printf("Original sequence S: ");
     traverse_chunk_LL(sequence);
 
+    // Multi-pattern mode: apply a whole dictionary of rewrite rules in a single pass
+    if (argc == 3 && strcmp(argv[1], "--rules") == 0)
+    {
+        Rule *rules;
+        int num_rules = input_rules(argv[2], &rules);
+        Automaton *ac = create_automaton(rules, num_rules);
+
+        Chunk *old_sequence = sequence;
+        sequence = replace_all_rules(sequence, ac);
+        printf("After applying %d rules, S: ", num_rules);
+        traverse_chunk_LL(sequence);
+
+        free_automaton(ac);
+        for (int r = 0; r < num_rules; r++)
+        {
+            free_LL(rules[r].pattern);
+            free_LL(rules[r].text);
+        }
+        free(rules);
+        free_chunk_LL(old_sequence);
+        free_chunk_LL(sequence);
+        pool_destroy(&chunk_pool);
+        pool_destroy(&node_pool);
+        return 0;
+    }
+
     // printf("\nEnter pattern: ");
     // Node *pattern = input_pattern();
     // printf("Enter replacement text: ");
@@ -478,6 +3362,149 @@ int main()
     // free_LL(pattern);
     // free_LL(text);
 
+    // Query mode: locate any number of patterns without replacing them. The first pattern is found by scanning the sequence;
+    // a suffix array of the sequence is built only if there are more queries, and then answers each of them in O(m log n) time
+    if (argc == 2 && strcmp(argv[1], "--find") == 0)
+    {
+        MatchIndex *index = NULL;
+        long long positions[10];
+        char flag = 'y';
+        while (flag == 'y')
+        {
+            printf("\nEnter pattern: ");
+            Node *pattern = input_pattern();
+            if (index == NULL)
+            {
+                long long count = count_matches(sequence, pattern);
+                print_matches(count, positions, find_matches(sequence, pattern, positions, 10));
+            }
+            else
+            {
+                long long count = index_count_matches(index, pattern);
+                print_matches(count, positions, index_find_matches(index, pattern, positions, 10));
+            }
+            free_LL(pattern);
+
+            printf("Do you want to continue? (y/n): ");
+            scanf(" %c", &flag);
+            if (flag == 'y' && index == NULL)
+            {
+                index = build_match_index(sequence);
+            }
+        }
+        printf("\n");
+        if (index != NULL)
+        {
+            free_match_index(index);
+        }
+        free_chunk_LL(sequence);
+        pool_destroy(&chunk_pool);
+        pool_destroy(&node_pool);
+        return 0;
+    }
+
+    // Edit mode: keep the sequence as a persistent rope, edit it by offset, and undo edits (every version shares the unchanged pieces)
+    if (argc == 2 && strcmp(argv[1], "--edit") == 0)
+    {
+        int num_versions = 1, capacity = 16;
+        Rope **versions = (Rope **) malloc(capacity * sizeof(Rope *));
+        versions[0] = rope_from_chunks(sequence);
+        char op = 'y';
+        while (op != 'q')
+        {
+            printf("\nEnter operation (i: insert, d: delete, r: replace range, p: replace pattern, u: undo, q: quit): ");
+            if (scanf(" %c", &op) != 1 || op == 'q')
+            {
+                break;
+            }
+            Rope *current = versions[num_versions - 1], *next = NULL;
+            long long offset = 0, length = 0;
+            if (op == 'i' || op == 'd' || op == 'r')
+            {
+                printf("Enter offset: ");
+                if (scanf("%lld", &offset) != 1)
+                {
+                    break;
+                }
+            }
+            if (op == 'd' || op == 'r')
+            {
+                printf("Enter length: ");
+                if (scanf("%lld", &length) != 1)
+                {
+                    break;
+                }
+            }
+            if ((op == 'i' || op == 'd' || op == 'r') && (offset < 0 || length < 0 || offset + length > rope_length(current)))
+            {
+                printf("Invalid range: the sequence has %lld integers.\n", rope_length(current));
+                continue;
+            }
+
+            if (op == 'i' || op == 'r')
+            {
+                printf("Enter text: ");
+                Node *text = input_pattern();
+                next = rope_replace(current, offset, length, text);
+                free_LL(text);
+            }
+            else if (op == 'd')
+            {
+                next = rope_delete(current, offset, length);
+            }
+            else if (op == 'p')
+            {
+                printf("Enter pattern: ");
+                Node *pattern = input_pattern();
+                printf("Enter replacement text: ");
+                Node *text = input_pattern();
+                next = rope_replace_all(current, pattern, text);
+                free_LL(pattern);
+                free_LL(text);
+            }
+            else if (op == 'u')
+            {
+                if (num_versions > 1)
+                {
+                    rope_release(versions[--num_versions]);
+                }
+            }
+            else
+            {
+                continue; // unknown operation
+            }
+
+            if (op != 'u')
+            {
+                if (num_versions == capacity)
+                {
+                    capacity *= 2;
+                    versions = (Rope **) realloc(versions, capacity * sizeof(Rope *));
+                }
+                versions[num_versions++] = next;
+            }
+            Chunk *flat = rope_to_chunks(versions[num_versions - 1]);
+            printf("S (version %d): ", num_versions - 1);
+            traverse_chunk_LL(flat);
+            free_chunk_LL(flat);
+        }
+        printf("\n");
+        while (num_versions > 0)
+        {
+            rope_release(versions[--num_versions]);
+        }
+        free(versions);
+        free_chunk_LL(sequence);
+        pool_destroy(&chunk_pool);
+        pool_destroy(&node_pool);
+        return 0;
+    }
+
+    // In-place mode: splice the replacements into the existing chunk list instead of building a new list
+    int in_place = (argc == 2 && strcmp(argv[1], "--in-place") == 0);
+    // Parallel mode: --parallel threads, e.g. --parallel 4
+    int threads = (argc == 3 && strcmp(argv[1], "--parallel") == 0) ? atoi(argv[2]) : 1;
+
     char flag = 'y';
     while (flag == 'y')
     {
@@ -488,7 +3515,19 @@ int main()
 
         Chunk *old_sequence = sequence;
         // detect_all_patterns(sequence, pattern);
-        sequence = replace_all_patterns(sequence, pattern, text);
+        if (in_place)
+        {
+            sequence = replace_in_place(sequence, pattern, text);
+            old_sequence = NULL; // the original sequence was modified, not copied
+        }
+        else if (threads > 1)
+        {
+            sequence = replace_all_patterns_parallel(sequence, pattern, text, threads);
+        }
+        else
+        {
+            sequence = replace_all_patterns(sequence, pattern, text);
+        }
         printf("After replacement, S: ");
         traverse_chunk_LL(sequence);
 
@@ -503,5 +3542,7 @@ int main()
 
     printf("\n");
     free_chunk_LL(sequence);
+    pool_destroy(&chunk_pool);
+    pool_destroy(&node_pool);
     return 0;
 }
\ No newline at end of file
@@ -3,8 +3,11 @@
 #include <limits.h>
 #include <ctype.h>
 #include <string.h>
+#include <pthread.h>
+#include "../tokenizer.h"
 
-#define MAX_LEN 10000
+#define MAX_LEN 10000 // initial size of the buffer of an input line (it grows for longer lines)
+#define MAX_THREADS 64 // largest number of threads used by 'multiply_poly_parallel'
 
 typedef struct Node 
 {
@@ -135,181 +138,1385 @@ Node* insert_node(Node *head, Node *new_node)
 	return head;
 }
 
+// Polynomial stored as contiguous arrays of its terms in sorted order (structure of arrays)
+typedef struct PolyArray
+{
+    int count; // number of terms
+    long long *key; // monomial key of every term (see 'monomial_key'), in descending order
+    float *coef; // coefficient of every term
+} PolyArray;
+
+// Function to pack the exponents of a term into a 64 bit key, such that keys in descending order are the terms in sorted order
+// (total degree in the high 32 bits, exponent of x with its sign bit flipped in the low 32 bits; the total degree must fit in an int)
+long long monomial_key(int i, int j)
+{
+    return (long long) (i + j) * 4294967296LL + ((unsigned) i ^ 0x80000000u);
+}
+
+// Functions to unpack the exponents of a monomial key
+int key_i(long long key)
+{
+    return (int) ((unsigned) key ^ 0x80000000u);
+}
+
+int key_j(long long key)
+{
+    return (int) ((key - (long long) ((unsigned) key)) / 4294967296LL) - key_i(key);
+}
+
+// Function to allocate the arrays of a polynomial with room for 'capacity' terms
+PolyArray new_poly_array(int capacity)
+{
+    PolyArray poly;
+    poly.count = 0;
+    poly.key = (long long *) malloc((capacity > 0 ? capacity : 1) * sizeof(long long));
+    poly.coef = (float *) malloc((capacity > 0 ? capacity : 1) * sizeof(float));
+    return poly;
+}
+
+void free_poly_array(PolyArray *poly)
+{
+    free(poly->key);
+    free(poly->coef);
+}
+
+// Function to copy a (sorted) polynomial linked list into arrays
+PolyArray poly_to_array(Node *head)
+{
+    int count = 0;
+    for (Node *node = head; node != NULL; node = node -> next)
+    {
+        count++;
+    }
+    PolyArray poly = new_poly_array(count);
+    for (Node *node = head; node != NULL; node = node -> next)
+    {
+        poly.key[poly.count] = monomial_key(node->i, node->j);
+        poly.coef[poly.count] = node->p;
+        poly.count++;
+    }
+    return poly;
+}
+
+// Function to build a polynomial linked list from the terms of a polynomial stored in arrays
+Node *array_to_poly(PolyArray *poly)
+{
+    Node *head = NULL, *tail = NULL;
+    for (int k = 0; k < poly->count; k++)
+    {
+        Node *new_node = create_node();
+        fill_node(new_node, key_i(poly->key[k]), key_j(poly->key[k]), poly->coef[k]);
+        if (head == NULL)
+        {
+            head = new_node;
+        }
+        else
+        {
+            new_node -> prev = tail;
+            tail -> next = new_node;
+        }
+        tail = new_node;
+    }
+    return head;
+}
+
+// Function to sort the terms of a polynomial stored in arrays (given in any order), and merge the terms with the same exponents
+// This is a radix sort on the keys (least significant byte first, skipping the bytes which are the same in every key), which takes
+// O(n) time; it is stable, so like terms are added in the order in which they were given (the same as 'insert_node').
+void sort_poly_array(PolyArray *poly)
+{
+    int n = poly->count;
+    // Sort the keys in ascending order of ~(key with its sign bit flipped), which is the descending order of the keys
+    unsigned long long *keys = (unsigned long long *) malloc((n > 0 ? n : 1) * sizeof(unsigned long long));
+    unsigned long long *keys_temp = (unsigned long long *) malloc((n > 0 ? n : 1) * sizeof(unsigned long long));
+    float *coef_temp = (float *) malloc((n > 0 ? n : 1) * sizeof(float));
+    float *coef = poly->coef;
+    int count[8][256];
+    memset(count, 0, sizeof(count));
+    for (int k = 0; k < n; k++)
+    {
+        keys[k] = ~((unsigned long long) poly->key[k] ^ 0x8000000000000000ULL);
+        for (int byte = 0; byte < 8; byte++)
+        {
+            count[byte][(keys[k] >> (8 * byte)) & 255]++;
+        }
+    }
+    for (int byte = 0; byte < 8; byte++)
+    {
+        if (n == 0 || count[byte][(keys[0] >> (8 * byte)) & 255] == n)
+        {
+            continue;
+        }
+        int start = 0;
+        for (int digit = 0; digit < 256; digit++)
+        {
+            int size = count[byte][digit];
+            count[byte][digit] = start;
+            start += size;
+        }
+        for (int k = 0; k < n; k++)
+        {
+            int pos = count[byte][(keys[k] >> (8 * byte)) & 255]++;
+            keys_temp[pos] = keys[k];
+            coef_temp[pos] = coef[k];
+        }
+        unsigned long long *swap_keys = keys;
+        keys = keys_temp;
+        keys_temp = swap_keys;
+        float *swap_coef = coef;
+        coef = coef_temp;
+        coef_temp = swap_coef;
+    }
+
+    // Merge like terms (which are now adjacent) back into the arrays of the polynomial
+    int terms = 0;
+    for (int k = 0; k < n; k++)
+    {
+        long long key = (long long) (~keys[k] ^ 0x8000000000000000ULL);
+        if (terms > 0 && poly->key[terms - 1] == key)
+        {
+            poly->coef[terms - 1] = poly->coef[terms - 1] + coef[k];
+        }
+        else
+        {
+            poly->key[terms] = key;
+            poly->coef[terms] = coef[k];
+            terms++;
+        }
+    }
+    poly->count = terms;
+    free(keys);
+    free(keys_temp);
+    free(coef == poly->coef ? coef_temp : coef);
+}
+
+// Function to parse a polynomial given as comma-separated terms "(i,j,p)" (e.g. "(2,1,3.5),(0,0,-1)") into a sorted linked list
+// Returns 0 if the polynomial is malformed (the error is recorded in 'tok', and 'head' holds the terms before the error)
+// The terms are collected in arrays and sorted at once by 'sort_poly_array', so building an n term polynomial takes O(n) time
+// (inserting every term into the sorted list with 'insert_node' takes O(n^2) time)
+int parse_poly(Tokenizer *tok, Node **head)
+{
+    int capacity = 16, valid = 1;
+    PolyArray poly = new_poly_array(capacity);
+    while (tokenizer_peek(tok) != -1)
+    {
+        // Extract polynomial terms (3 comma-seperated values)
+        int i, j;
+        float p;
+        if (!tokenizer_expect(tok, '(') || !tokenizer_int(tok, &i) || !tokenizer_expect(tok, ',') || !tokenizer_int(tok, &j)
+            || !tokenizer_expect(tok, ',') || !tokenizer_float(tok, &p) || !tokenizer_expect(tok, ')'))
+        {
+            valid = 0;
+            break;
+        }
+        if (poly.count == capacity)
+        {
+            capacity *= 2;
+            poly.key = (long long *) realloc(poly.key, capacity * sizeof(long long));
+            poly.coef = (float *) realloc(poly.coef, capacity * sizeof(float));
+        }
+        poly.key[poly.count] = monomial_key(i, j);
+        poly.coef[poly.count] = p;
+        poly.count++;
+
+        // Terms are separated by ','
+        if (tokenizer_peek(tok) != -1 && !tokenizer_expect(tok, ','))
+        {
+            valid = 0;
+            break;
+        }
+    }
+
+    // Sort the terms, merge like terms and link them in one pass
+    sort_poly_array(&poly);
+    *head = array_to_poly(&poly);
+    free_poly_array(&poly);
+    return valid;
+}
+
+// Function to read the next word of the input (skipping whitespace) into a buffer of any length, which the caller must free
+char *read_word()
+{
+    int capacity = MAX_LEN, length = 0, c;
+    char *str = (char *) malloc(capacity);
+    while ((c = getchar()) != EOF && isspace(c))
+    {
+    }
+    while (c != EOF && !isspace(c))
+    {
+        if (length + 1 == capacity)
+        {
+            capacity *= 2;
+            str = (char *) realloc(str, capacity);
+        }
+        str[length++] = (char) c;
+        c = getchar();
+    }
+    if (c != EOF)
+    {
+        ungetc(c, stdin);
+    }
+    str[length] = 0;
+    return str;
+}
+
 // Function to take polynomial as input and store it using linked lists
 Node* input()
 {
-    // take polynomial input from a single line as a string
-    // and parse the input string to get individual terms of the polynomial
-    char *str = (char *) calloc(MAX_LEN, sizeof(char)); 
-    Node *head = NULL, *node = NULL;
-    memset(str, 0, MAX_LEN);
+    // take polynomial input from a single line as a string
+    // and parse the input string to get individual terms of the polynomial
+    char *str = read_word();
+    Node *head = NULL;
+
+    Tokenizer tok;
+    tokenizer_init(&tok, str, strlen(str));
+    if (!parse_poly(&tok, &head))
+    {
+        tokenizer_report(&tok, "Invalid polynomial", stderr);
+        exit(1);
+    }
+
+    // now return the head of the created polynomial LL
+    // And free the heap memory which is no longer required
+    free(str);
+    return head;
+}
+
+// Function to add two polynomials stored in arrays, and return the resulting polynomial
+// Both term lists are merged in one pass; the loop has no unpredictable branches: every step compares the current keys once,
+// takes the term (or terms) with the larger key, and adds -0.0 in place of the coefficient of a term which is not taken
+// (x + -0.0 is exactly x for every x, including -0.0), so the coefficients are the same as adding the linked lists.
+PolyArray add_poly_array(PolyArray *a, PolyArray *b)
+{
+    PolyArray result = new_poly_array(a->count + b->count);
+    int x = 0, y = 0, k = 0;
+    while (x < a->count && y < b->count)
+    {
+        long long key_a = a->key[x], key_b = b->key[y];
+        int take_a = (key_a >= key_b), take_b = (key_b >= key_a);
+        result.key[k] = take_a ? key_a : key_b;
+        result.coef[k] = (take_a ? a->coef[x] : -0.0f) + (take_b ? b->coef[y] : -0.0f);
+        x += take_a;
+        y += take_b;
+        k++;
+    }
+    // Copy the remaining terms of the polynomial which has not ended
+    memcpy(result.key + k, a->key + x, (a->count - x) * sizeof(long long));
+    memcpy(result.coef + k, a->coef + x, (a->count - x) * sizeof(float));
+    k += a->count - x;
+    memcpy(result.key + k, b->key + y, (b->count - y) * sizeof(long long));
+    memcpy(result.coef + k, b->coef + y, (b->count - y) * sizeof(float));
+    k += b->count - y;
+    result.count = k;
+    return result;
+}
+
+// Function to add two polynomials stored as linked lists, and return the resulting polynomial
+// (the lists are copied into arrays, which are merged by 'add_poly_array')
+Node *add_poly(Node *p1, Node *p2)
+{
+    PolyArray a = poly_to_array(p1), b = poly_to_array(p2);
+    PolyArray sum = add_poly_array(&a, &b);
+    Node *result = array_to_poly(&sum);
+    free_poly_array(&a);
+    free_poly_array(&b);
+    free_poly_array(&sum);
+    return result;
+}
+
+// Function to multiply two polynomials stored as linked lists, and return the resulting polynomial
+// (naive method: every partial product is added to the result with 'add_poly', which takes O(n * m * (n * m)) time)
+Node *multiply_poly_naive(Node *p1, Node *p2)
+{
+    // The logic is to multiply each element of p2 with all elements of p1 to get partial products
+    // And then add up all the intermediate polynomials using the add function
+
+    Node *result = NULL;
+    // result holds the final resulting polynomial whereas 
+    // 'partial' holds the intermediate partial products which have to be added up
+
+    while (p2 != NULL)
+    {
+        // Create a deep copy of polynomial p1 called 'partial' (to preserve the original polynomial p1)
+        // And multiply each term of partial (p1) with current term of p2 to compute the partial product
+        Node *partial = deep_copy_LL(p1);
+        Node *node = partial;
+        while (node != NULL)
+        {
+            // Perform multiplication on current pair of terms of polynomials partial(p1) and p2
+            node->i = node->i + p2->i;
+            node->j = node->j + p2->j;
+            node->p = node->p * p2->p;
+
+            node = node -> next;
+        }
+
+        // Now 'partial' contains the partial product corresponding to one term of p2
+        // Add it to 'result'
+        result = add_poly(result, partial);
+        p2 = p2 -> next;
+        free_LL(partial); // Free the partial LL which is no longer required 
+    }
+
+    return result;
+}
+
+// Term of a polynomial in the hash table used by 'multiply_poly_hash'
+typedef struct Term
+{
+    long long key; // packed exponents (i << 32 | j), used for hashing
+    int i, j;
+    float p;
+    int used; // 0 for an empty slot of the hash table
+} Term;
+
+// Function to pack the exponents of a term into a single 64 bit key
+long long pack_key(int i, int j)
+{
+    return (long long) (((unsigned long long) (unsigned) i << 32) | (unsigned) j);
+}
+
+// Function to compare terms in the sorted order of polynomials (total degree descending, then i descending), for qsort
+int compare_terms(const void *a, const void *b)
+{
+    const Term *x = (const Term *) a, *y = (const Term *) b;
+    long long degree_x = (long long) x->i + x->j, degree_y = (long long) y->i + y->j;
+    if (degree_x != degree_y)
+    {
+        return (degree_x > degree_y) ? -1 : 1;
+    }
+    return (x->i > y->i) ? -1 : (x->i < y->i);
+}
+
+// Function to build a polynomial linked list from terms which are already sorted
+Node *build_poly(Term *terms, int count)
+{
+    Node *head = NULL, *tail = NULL;
+    for (int k = 0; k < count; k++)
+    {
+        Node *new_node = create_node();
+        fill_node(new_node, terms[k].i, terms[k].j, terms[k].p);
+        if (head == NULL)
+        {
+            head = new_node;
+        }
+        else
+        {
+            new_node -> prev = tail;
+            tail -> next = new_node;
+        }
+        tail = new_node;
+    }
+    return head;
+}
+
+// Function to add a product term to a hash table of terms (open addressing on the packed key, 'capacity' is 2^(64 - shift))
+// Returns 1 if the term is new, and 0 if it was added to an existing term with the same exponents
+int table_add(Term *table, long long capacity, int shift, int i, int j, float p)
+{
+    long long key = pack_key(i, j);
+    long long slot = (long long) (((unsigned long long) key * 0x9E3779B97F4A7C15ULL) >> shift);
+    while (table[slot].used && table[slot].key != key)
+    {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    if (table[slot].used)
+    {
+        table[slot].p = table[slot].p + p;
+        return 0;
+    }
+    table[slot].key = key;
+    table[slot].i = i;
+    table[slot].j = j;
+    table[slot].p = p;
+    table[slot].used = 1;
+    return 1;
+}
+
+// Function to move the 'count' terms of a hash table to its front, and sort them
+void table_collect(Term *table, long long capacity, int count)
+{
+    int k = 0;
+    for (long long slot = 0; slot < capacity; slot++)
+    {
+        if (table[slot].used)
+        {
+            table[k++] = table[slot];
+        }
+    }
+    qsort(table, count, sizeof(Term), compare_terms);
+}
+
+// Function to multiply two polynomials using a hash table of the product terms, and return the resulting polynomial
+// Every product of a term of p1 and a term of p2 is added to the entry of its exponents (open addressing on the packed key),
+// and the entries are sorted once at the end, so this takes O(n * m) expected time (plus sorting the result).
+// Products are added in the same order as 'multiply_poly_naive' (terms of p2 outside), so the coefficients are identical.
+Node *multiply_poly_hash(Node *p1, Node *p2)
+{
+    long long n = 0, m = 0;
+    for (Node *node = p1; node != NULL; node = node -> next)
+    {
+        n++;
+    }
+    for (Node *node = p2; node != NULL; node = node -> next)
+    {
+        m++;
+    }
+
+    // Table size: a power of 2 which is atleast twice the number of products (so the table is atmost half full)
+    long long capacity = 16;
+    while (capacity < 2 * n * m)
+    {
+        capacity *= 2;
+    }
+    Term *table = (Term *) calloc(capacity, sizeof(Term));
+    int shift = 64;
+    for (long long c = capacity; c > 1; c /= 2)
+    {
+        shift--;
+    }
+
+    int count = 0;
+    for (Node *node2 = p2; node2 != NULL; node2 = node2 -> next)
+    {
+        for (Node *node1 = p1; node1 != NULL; node1 = node1 -> next)
+        {
+            count += table_add(table, capacity, shift, node1->i + node2->i, node1->j + node2->j, node1->p * node2->p);
+        }
+    }
+
+    // Move the terms to the front of the table and sort them
+    table_collect(table, capacity, count);
+    Node *result = build_poly(table, count);
+    free(table);
+    return result;
+}
+
+// Work of one thread of 'multiply_poly_parallel': the products whose total degree is in [low, high]
+typedef struct MultiplyTask
+{
+    PolyArray *p1, *p2; // the polynomials being multiplied
+    long long *degree1, *degree2; // total degree of every term of p1 and p2 (in descending order)
+    long long low, high; // range of total degrees of the products computed by this task
+    Term *terms; // sorted terms of the product with total degree in [low, high]
+    int count; // number of terms in 'terms'
+} MultiplyTask;
+
+// Function to find the first term whose total degree is atmost 'value' in an array of degrees in descending order
+int first_atmost(long long *degree, int count, long long value)
+{
+    int low = 0, high = count;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (degree[mid] > value)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Function to count the products of terms of p1 and p2 with total degree atleast 'value'
+long long count_products(long long *degree1, int n, long long *degree2, int m, long long value)
+{
+    long long count = 0;
+    for (int b = 0; b < m; b++)
+    {
+        count += first_atmost(degree1, n, value - degree2[b] - 1);
+    }
+    return count;
+}
+
+// Function run by every thread of 'multiply_poly_parallel'
+// For every term of p2 (in order), the terms of p1 whose products fall in the task's degree range are contiguous, since p1 is
+// sorted by degree; they are found by binary search and added to a hash table private to the thread, in the same order as in
+// 'multiply_poly_hash', so every coefficient is summed in the same order whatever the number of threads.
+void *multiply_worker(void *arg)
+{
+    MultiplyTask *task = (MultiplyTask *) arg;
+    int n = task->p1->count, m = task->p2->count;
+    long long products = 0;
+    for (int b = 0; b < m; b++)
+    {
+        products += first_atmost(task->degree1, n, task->low - task->degree2[b] - 1) - first_atmost(task->degree1, n, task->high - task->degree2[b]);
+    }
+
+    long long capacity = 16;
+    while (capacity < 2 * products)
+    {
+        capacity *= 2;
+    }
+    int shift = 64;
+    for (long long c = capacity; c > 1; c /= 2)
+    {
+        shift--;
+    }
+    Term *table = (Term *) calloc(capacity, sizeof(Term));
+    int count = 0;
+    for (int b = 0; b < m; b++)
+    {
+        int i2 = key_i(task->p2->key[b]), j2 = key_j(task->p2->key[b]);
+        float p2 = task->p2->coef[b];
+        int last = first_atmost(task->degree1, n, task->low - task->degree2[b] - 1);
+        for (int a = first_atmost(task->degree1, n, task->high - task->degree2[b]); a < last; a++)
+        {
+            count += table_add(table, capacity, shift, key_i(task->p1->key[a]) + i2, key_j(task->p1->key[a]) + j2, task->p1->coef[a] * p2);
+        }
+    }
+    table_collect(table, capacity, count);
+    task->terms = table;
+    task->count = count;
+    return NULL;
+}
+
+// Function to multiply two polynomials using 'threads' threads, and return the resulting polynomial
+// The total degrees of the product are split into 'threads' ranges with about the same number of products (found by binary search
+// on the number of products above a degree), and every thread computes the terms of one range with its own hash table. The ranges
+// are disjoint and ordered, so the sorted terms of the threads are concatenated into the result. Every coefficient is computed by
+// a single thread in the order of 'multiply_poly_naive', so the result is identical for any number of threads.
+Node *multiply_poly_parallel(Node *p1, Node *p2, int threads)
+{
+    if (p1 == NULL || p2 == NULL)
+    {
+        return NULL;
+    }
+    threads = (threads < 1) ? 1 : (threads > MAX_THREADS) ? MAX_THREADS : threads;
+    PolyArray a = poly_to_array(p1), b = poly_to_array(p2);
+    long long *degree1 = (long long *) malloc(a.count * sizeof(long long));
+    long long *degree2 = (long long *) malloc(b.count * sizeof(long long));
+    for (int k = 0; k < a.count; k++)
+    {
+        degree1[k] = (long long) key_i(a.key[k]) + key_j(a.key[k]);
+    }
+    for (int k = 0; k < b.count; k++)
+    {
+        degree2[k] = (long long) key_i(b.key[k]) + key_j(b.key[k]);
+    }
+
+    // Split the degrees: task t gets the degrees in [bound[t + 1], bound[t] - 1]
+    long long total = (long long) a.count * b.count;
+    long long bound[MAX_THREADS + 1];
+    bound[0] = degree1[0] + degree2[0] + 1;
+    bound[threads] = degree1[a.count - 1] + degree2[b.count - 1];
+    for (int t = 1; t < threads; t++)
+    {
+        // Smallest degree with atmost t / threads of the products at or above it
+        long long low = bound[threads], high = bound[t - 1];
+        while (low < high)
+        {
+            long long mid = low + (high - low) / 2;
+            if (count_products(degree1, a.count, degree2, b.count, mid) <= total * t / threads)
+            {
+                high = mid;
+            }
+            else
+            {
+                low = mid + 1;
+            }
+        }
+        bound[t] = low;
+    }
+
+    MultiplyTask tasks[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+    for (int t = 0; t < threads; t++)
+    {
+        tasks[t].p1 = &a;
+        tasks[t].p2 = &b;
+        tasks[t].degree1 = degree1;
+        tasks[t].degree2 = degree2;
+        tasks[t].low = bound[t + 1];
+        tasks[t].high = bound[t] - 1;
+        if (t > 0)
+        {
+            pthread_create(&ids[t], NULL, multiply_worker, &tasks[t]);
+        }
+    }
+    multiply_worker(&tasks[0]);
+
+    // Link the terms of the tasks in order of decreasing degree
+    Node *head = NULL, *tail = NULL;
+    for (int t = 0; t < threads; t++)
+    {
+        if (t > 0)
+        {
+            pthread_join(ids[t], NULL);
+        }
+        Node *part = build_poly(tasks[t].terms, tasks[t].count);
+        free(tasks[t].terms);
+        if (part == NULL)
+        {
+            continue;
+        }
+        if (head == NULL)
+        {
+            head = part;
+        }
+        else
+        {
+            tail -> next = part;
+            part -> prev = tail;
+        }
+        for (tail = part; tail -> next != NULL; tail = tail -> next)
+        {
+        }
+    }
+    free(degree1);
+    free(degree2);
+    free_poly_array(&a);
+    free_poly_array(&b);
+    return head;
+}
+
+// Entry of the heap used by 'multiply_poly_heap': the stream of products of one term of p1 with the terms of p2
+typedef struct Stream
+{
+    Node *term1; // term of p1
+    Node *term2; // current term of p2 (the stream's next product is term1 * term2)
+    int index2; // position of term2 in p2
+    long long degree; // total degree of the next product
+    int i; // exponent of x in the next product
+} Stream;
+
+// Function to check whether the next product of stream 'a' comes before that of stream 'b' in the output
+// Products with the same exponents are taken in the order of their terms of p2 (as in 'multiply_poly_naive')
+int stream_before(Stream *a, Stream *b)
+{
+    if (a->degree != b->degree)
+    {
+        return a->degree > b->degree;
+    }
+    if (a->i != b->i)
+    {
+        return a->i > b->i;
+    }
+    return a->index2 < b->index2;
+}
+
+// Function to restore the heap order after the stream at 'k' has moved back (or been replaced)
+void sift_down(Stream *heap, int size, int k)
+{
+    while (1)
+    {
+        int first = k, left = 2 * k + 1, right = 2 * k + 2;
+        if (left < size && stream_before(&heap[left], &heap[first]))
+        {
+            first = left;
+        }
+        if (right < size && stream_before(&heap[right], &heap[first]))
+        {
+            first = right;
+        }
+        if (first == k)
+        {
+            return;
+        }
+        Stream temp = heap[k];
+        heap[k] = heap[first];
+        heap[first] = temp;
+        k = first;
+    }
+}
+
+// Function to set the next product of a stream
+void stream_load(Stream *stream)
+{
+    stream->degree = (long long) stream->term1->i + stream->term2->i + stream->term1->j + stream->term2->j;
+    stream->i = stream->term1->i + stream->term2->i;
+}
 
-    scanf("%s", str);
+// Function to multiply two polynomials by merging the n sorted streams p1[k] * p2 with a heap (Johnson's algorithm)
+// Since multiplying by a term preserves the order of terms, every stream is already sorted; the heap always holds the next product
+// of every stream, so products come out in sorted order and like terms are merged as they come. This takes O(n * m * log n) time
+// and O(n) extra memory, and no partial product is materialised. The coefficients are identical to 'multiply_poly_naive'.
+Node *multiply_poly_heap(Node *p1, Node *p2)
+{
+    int n = 0;
+    for (Node *node = p1; node != NULL; node = node -> next)
+    {
+        n++;
+    }
+    if (n == 0 || p2 == NULL)
+    {
+        return NULL;
+    }
 
-    // Parse input string str and extract the comma-seperated numbers
-    int i = 0, j;
-    while (str[i] != 0)
+    Stream *heap = (Stream *) malloc(n * sizeof(Stream));
+    int size = 0;
+    for (Node *node = p1; node != NULL; node = node -> next)
     {
-        Node *new_node = create_node();
+        heap[size].term1 = node;
+        heap[size].term2 = p2;
+        heap[size].index2 = 0;
+        stream_load(&heap[size]);
+        size++;
+    }
+    for (int k = size / 2 - 1; k >= 0; k--)
+    {
+        sift_down(heap, size, k);
+    }
 
-        // Extract polynomial terms (3 comma-seperated values)
-        for (int k = 0; k < 3; k++)
+    Node *head = NULL, *tail = NULL;
+    while (size > 0)
+    {
+        // Take the next product, and add it to the last term of the result if the exponents are the same
+        Stream *stream = &heap[0];
+        int i = stream->i, j = (int) (stream->degree - stream->i);
+        float p = stream->term1->p * stream->term2->p;
+        if (tail != NULL && tail->i == i && tail->j == j)
+        {
+            tail->p = tail->p + p;
+        }
+        else
         {
-            i++;
-            int j = 0;
-            char num[50] = ""; // temporary string to store numeric data
-            while (isdigit(str[i]) || str[i] == '.' || str[i] == '-')
+            Node *new_node = create_node();
+            fill_node(new_node, i, j, p);
+            if (head == NULL)
             {
-                num[j] = str[i];
-                i++;
-                j++;
+                head = new_node;
             }
-            num[j] = 0; // Append 0 at the end of the string
-
-            if (k == 0)
-                new_node -> i = atoi(num);
-            else if (k == 1)
-                new_node -> j = atoi(num);
             else
-                new_node -> p = atof(num);
+            {
+                new_node -> prev = tail;
+                tail -> next = new_node;
+            }
+            tail = new_node;
+        }
 
+        // Advance the stream, or remove it if it has ended
+        stream->term2 = stream->term2->next;
+        stream->index2++;
+        if (stream->term2 != NULL)
+        {
+            stream_load(stream);
+        }
+        else
+        {
+            heap[0] = heap[--size];
         }
+        sift_down(heap, size, 0);
+    }
+    free(heap);
+    return head;
+}
+
+#define DENSE_MIN_DENSITY 0.5 // a polynomial is dense if atleast this fraction of its exponent rectangle are terms
+#define DENSE_MIN_PRODUCTS 65536 // 'multiply_poly' uses the dense method only for products of atleast this many pairs of terms
+#define DENSE_MAX_SIZE (1 << 24) // largest exponent rectangle of a product computed by the dense method
 
-        // Insert new_node into the linked list in sorted order
-        head = insert_node(head, new_node);
+// Polynomial stored as a 2D array of coefficients over the rectangle of its exponents (i0 <= i < i0 + rows, j0 <= j < j0 + cols)
+typedef struct DensePoly
+{
+    int i0, j0; // smallest exponents of x and y
+    int rows, cols; // number of exponents of x and y in the rectangle
+    float *coef; // coef[(i - i0) * cols + (j - j0)] is the coefficient of the term (i, j)
+    unsigned char *present; // present[...] is 1 if the polynomial has the term (i, j) (its coefficient may still be 0)
+} DensePoly;
 
-        i += 2; // Skip the ')' and ',' characters in input 'str'
+// Function to find the rectangle of the exponents of a polynomial; returns the number of terms (0 for an empty polynomial)
+long long poly_bounds(Node *node, int *i0, int *i1, int *j0, int *j1)
+{
+    long long count = 0;
+    for (; node != NULL; node = node -> next)
+    {
+        if (count == 0 || node->i < *i0) *i0 = node->i;
+        if (count == 0 || node->i > *i1) *i1 = node->i;
+        if (count == 0 || node->j < *j0) *j0 = node->j;
+        if (count == 0 || node->j > *j1) *j1 = node->j;
+        count++;
     }
-    // now return the head of the created polynomial LL
-    // And free the heap memory which is no longer required
-    free(str);
-    return head;
+    return count;
 }
 
-// Function to add two polynomials stored as linked lists, and return the resulting polynomial
-Node *add_poly(Node *p1, Node *p2)
+// Function to check whether the exponent rectangle of the product of two (non-empty) polynomials is small enough
+// for the dense method (atmost DENSE_MAX_SIZE exponents)
+int dense_fits(Node *p1, Node *p2)
+{
+    int a_i0 = 0, a_i1 = 0, a_j0 = 0, a_j1 = 0, b_i0 = 0, b_i1 = 0, b_j0 = 0, b_j1 = 0;
+    poly_bounds(p1, &a_i0, &a_i1, &a_j0, &a_j1);
+    poly_bounds(p2, &b_i0, &b_i1, &b_j0, &b_j1);
+    long long rows = ((long long) a_i1 - a_i0) + ((long long) b_i1 - b_i0) + 1;
+    long long cols = ((long long) a_j1 - a_j0) + ((long long) b_j1 - b_j0) + 1;
+    return rows <= DENSE_MAX_SIZE && cols <= DENSE_MAX_SIZE && rows * cols <= DENSE_MAX_SIZE;
+}
+
+// Function to check whether the product of two polynomials should be computed with the dense method:
+// both polynomials fill most of their exponent rectangles, and there are enough products for the FFT to pay off
+int use_dense(Node *p1, Node *p2)
 {
-    Node *result = NULL; // Stores the resulting polynomial after adding p1 and p2
+    int a_i0 = 0, a_i1 = 0, a_j0 = 0, a_j1 = 0, b_i0 = 0, b_i1 = 0, b_j0 = 0, b_j1 = 0;
+    long long n = poly_bounds(p1, &a_i0, &a_i1, &a_j0, &a_j1);
+    long long m = poly_bounds(p2, &b_i0, &b_i1, &b_j0, &b_j1);
+    if (n * m < DENSE_MIN_PRODUCTS || !dense_fits(p1, p2))
+    {
+        return 0;
+    }
+    long long a_rows = (long long) a_i1 - a_i0 + 1, a_cols = (long long) a_j1 - a_j0 + 1;
+    long long b_rows = (long long) b_i1 - b_i0 + 1, b_cols = (long long) b_j1 - b_j0 + 1;
+    return n >= DENSE_MIN_DENSITY * a_rows * a_cols && m >= DENSE_MIN_DENSITY * b_rows * b_cols;
+}
 
-    while (p1 != NULL && p2 != NULL)
+// Function to convert a (non-empty) polynomial linked list into a dense polynomial ('coef' or 'present' is NULL if there is not enough memory)
+DensePoly to_dense(Node *head)
+{
+    DensePoly poly;
+    int i1 = 0, j1 = 0;
+    poly_bounds(head, &poly.i0, &i1, &poly.j0, &j1);
+    poly.rows = i1 - poly.i0 + 1;
+    poly.cols = j1 - poly.j0 + 1;
+    poly.coef = (float *) calloc((size_t) poly.rows * poly.cols, sizeof(float));
+    poly.present = (unsigned char *) calloc((size_t) poly.rows * poly.cols, sizeof(unsigned char));
+    if (poly.coef == NULL || poly.present == NULL)
     {
-        Node *new_node = create_node();
+        return poly; // the caller checks the arrays
+    }
+    for (Node *node = head; node != NULL; node = node -> next)
+    {
+        long long k = (long long) (node->i - poly.i0) * poly.cols + (node->j - poly.j0);
+        poly.coef[k] = node->p;
+        poly.present[k] = 1;
+    }
+    return poly;
+}
 
-        if (p1->i == p2->i && p1->j == p2->j)
+// Function to convert a dense polynomial into a sorted polynomial linked list (of the terms which are present)
+Node *from_dense(DensePoly *poly)
+{
+    Node *head = NULL, *tail = NULL;
+    int i1 = poly->i0 + poly->rows - 1, j1 = poly->j0 + poly->cols - 1;
+    // Visit the rectangle by total degree (descending), and by exponent of x (descending) within a degree
+    for (long long degree = (long long) i1 + j1; degree >= (long long) poly->i0 + poly->j0; degree--)
+    {
+        long long first = (degree - poly->j0 < i1) ? degree - poly->j0 : i1;
+        long long last = (degree - j1 > poly->i0) ? degree - j1 : poly->i0;
+        for (long long i = first; i >= last; i--)
         {
-            fill_node(new_node, p1->i, p1->j, p1->p + p2->p);
-            p1 = p1 -> next;
-            p2 = p2 -> next;
+            long long k = (i - poly->i0) * poly->cols + (degree - i - poly->j0);
+            if (!poly->present[k])
+            {
+                continue;
+            }
+            Node *new_node = create_node();
+            fill_node(new_node, (int) i, (int) (degree - i), poly->coef[k]);
+            if (head == NULL)
+            {
+                head = new_node;
+            }
+            else
+            {
+                new_node -> prev = tail;
+                tail -> next = new_node;
+            }
+            tail = new_node;
         }
-        else if ((p1->i + p1->j > p2->i + p2->j) || ((p1->i + p1->j == p2->i + p2->j) && (p1->i > p2->i)))
+    }
+    return head;
+}
+
+// Complex number used by the FFT of 'multiply_poly_dense'
+typedef struct Complex
+{
+    double re, im;
+} Complex;
+
+Complex complex_mul(Complex a, Complex b)
+{
+    Complex c = {a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re};
+    return c;
+}
+
+// Function to compute the square root of a number in [0.5, 1] by Newton's method (so that the program needs no math library)
+double square_root(double x)
+{
+    double y = 1;
+    for (int k = 0; k < 8; k++)
+    {
+        y = (y + x / y) / 2;
+    }
+    return y;
+}
+
+// Function to fill 'roots' (of size n, a power of 2) with the roots of unity used by 'fft': roots[len + k] = e^(i * pi * k / len)
+// Every root is the product of atmost log(n) roots e^(i * pi / len), which are found by halving angles, so the error stays small
+void fft_roots(Complex *roots, int n)
+{
+    Complex root = {0, 1}; // e^(i * pi / len), starting with len = 2
+    roots[1].re = 1;
+    roots[1].im = 0;
+    for (int len = 2; len < n; len *= 2)
+    {
+        for (int k = len; k < 2 * len; k++)
         {
-            fill_node(new_node, p1->i, p1->j, p1->p);
-            p1 = p1 -> next;
+            roots[k] = (k & 1) ? complex_mul(roots[k / 2], root) : roots[k / 2];
         }
-        else 
+        // cos(t / 2) = sqrt((1 + cos(t)) / 2) and sin(t / 2) = sin(t) / (2 cos(t / 2))
+        double c = square_root((1 + root.re) / 2);
+        root.im = root.im / (2 * c);
+        root.re = c;
+    }
+}
+
+// Function to compute the discrete Fourier transform of 'a' (of size n, a power of 2) in place (iterative radix-2 FFT)
+void fft(Complex *a, Complex *roots, int n)
+{
+    // Put the elements in bit-reversed order
+    for (int k = 1, r = 0; k < n; k++)
+    {
+        int bit = n >> 1;
+        for (; r & bit; bit >>= 1)
         {
-            fill_node(new_node, p2->i, p2->j, p2->p);
-            p2 = p2 -> next;
+            r ^= bit;
         }
-        
-        // Now append the newly created node at the end of the result list
-        if (result == NULL)
+        r ^= bit;
+        if (k < r)
         {
-            result = new_node;
+            Complex temp = a[k];
+            a[k] = a[r];
+            a[r] = temp;
         }
-        else
+    }
+    for (int len = 1; len < n; len *= 2)
+    {
+        for (int start = 0; start < n; start += 2 * len)
         {
-            new_node -> prev = result;
-            result -> next = new_node;
-            result = result -> next;
+            for (int k = start; k < start + len; k++)
+            {
+                Complex z = complex_mul(roots[len + k - start], a[k + len]);
+                a[k + len].re = a[k].re - z.re;
+                a[k + len].im = a[k].im - z.im;
+                a[k].re += z.re;
+                a[k].im += z.im;
+            }
         }
     }
+}
 
-    while (p1 != NULL)
+// Function to compute the cyclic convolution of two real sequences of size n (given as 'data[k].re' and 'data[k].im') into 'result'
+// Both sequences are transformed at once: squaring the transform of a + ib gives (A^2 - B^2) + 2iAB, and the conjugate symmetry
+// of real transforms separates AB from it, so the convolution takes 2 FFTs instead of 3. 'data' is overwritten.
+// Returns 0 if there is not enough memory
+int convolve(Complex *data, Complex *roots, int n, double *result)
+{
+    Complex *out = (Complex *) malloc(n * sizeof(Complex));
+    if (out == NULL)
     {
-        Node *new_node = create_node();
-        fill_node(new_node, p1->i, p1->j, p1->p);
-        // Now append the newly created node at the end of the result list
-        if (result == NULL)
+        return 0;
+    }
+    fft(data, roots, n);
+    for (int k = 0; k < n; k++)
+    {
+        data[k] = complex_mul(data[k], data[k]);
+    }
+    for (int k = 0; k < n; k++)
+    {
+        Complex x = data[(n - k) & (n - 1)], y = data[k];
+        out[k].re = x.re - y.re;
+        out[k].im = x.im + y.im;
+    }
+    fft(out, roots, n);
+    for (int k = 0; k < n; k++)
+    {
+        result[k] = out[k].im / (4.0 * n);
+    }
+    free(out);
+    return 1;
+}
+
+// Function to compute the product c of two dense polynomials a and b (c's rectangle and arrays are already set up)
+// using the FFT arrays of size n = 2^levels allocated by 'multiply_poly_dense'; returns 0 if there is not enough memory
+int multiply_dense(DensePoly *a, DensePoly *b, DensePoly *c, Complex *roots, int n, int levels, Complex *data, double *coef, double *count)
+{
+    // Convolve the coefficients (a in the real parts, b in the imaginary parts)
+    // b is scaled by a power of 2 to the magnitude of a, since the error of 'convolve' grows with the larger of the two
+    double max_a = 0, max_b = 0, terms = 0, scale = 1;
+    for (long long k = 0; k < (long long) a->rows * a->cols; k++)
+    {
+        max_a = (a->coef[k] > max_a) ? a->coef[k] : (-a->coef[k] > max_a) ? -a->coef[k] : max_a;
+        terms += a->present[k];
+    }
+    for (long long k = 0; k < (long long) b->rows * b->cols; k++)
+    {
+        max_b = (b->coef[k] > max_b) ? b->coef[k] : (-b->coef[k] > max_b) ? -b->coef[k] : max_b;
+    }
+    while (max_b > 0 && max_b * scale * 2 <= max_a)
+    {
+        scale *= 2;
+    }
+    while (max_b * scale > 2 * max_a)
+    {
+        scale /= 2;
+    }
+    for (int r = 0; r < a->rows; r++)
+    {
+        for (int s = 0; s < a->cols; s++)
         {
-            result = new_node;
+            data[r * c->cols + s].re = a->coef[r * a->cols + s];
         }
-        else
+    }
+    for (int r = 0; r < b->rows; r++)
+    {
+        for (int s = 0; s < b->cols; s++)
         {
-            new_node -> prev = result;
-            result -> next = new_node;
-            result = result -> next;
+            data[r * c->cols + s].im = b->coef[r * b->cols + s] * scale;
         }
-        p1 = p1 -> next;
+    }
+    if (!convolve(data, roots, n, coef))
+    {
+        return 0;
     }
 
-    while (p2 != NULL)
+    // Convolve the 'present' arrays
+    memset(data, 0, n * sizeof(Complex));
+    for (int r = 0; r < a->rows; r++)
     {
-        Node *new_node = create_node();
-        fill_node(new_node, p2->i, p2->j, p2->p);
-        // Now append the newly created node at the end of the result list
-        if (result == NULL)
+        for (int s = 0; s < a->cols; s++)
         {
-            result = new_node;
+            data[r * c->cols + s].re = a->present[r * a->cols + s];
         }
-        else
+    }
+    for (int r = 0; r < b->rows; r++)
+    {
+        for (int s = 0; s < b->cols; s++)
         {
-            new_node -> prev = result;
-            result -> next = new_node;
-            result = result -> next;
+            data[r * c->cols + s].im = b->present[r * b->cols + s];
         }
-        p2 = p2 -> next;
+    }
+    if (!convolve(data, roots, n, count))
+    {
+        return 0;
     }
 
-    // Now traverse 'result' back to the head using prev pointers and then return the head
-    while (result -> prev != NULL)
+    // Bound on the error of the transform: every coefficient is a sum of atmost 'terms' products, each with an error of
+    // about (levels + 1) units in the last place of max_a * max_b
+    double noise = 4 * (levels + 1) * terms * max_a * max_b * scale * 2.220446049250313e-16;
+    for (long long k = 0; k < (long long) c->rows * c->cols; k++)
     {
-        result = result -> prev;
+        c->present[k] = (count[k] > 0.5);
+        c->coef[k] = (coef[k] > noise || coef[k] < -noise) ? (float) (coef[k] / scale) : 0;
     }
+    return 1;
+}
 
-    return result;
+// Function to multiply two polynomials stored as dense 2D arrays of coefficients, and return the resulting polynomial
+// The rectangles are flattened with the row length of the product (Kronecker substitution: y -> t, x -> t^cols), so that the
+// product of the polynomials is the product of two polynomials in t, which is computed by FFT in O(N log N) time (N is the size
+// of the rectangle of the product) instead of O(n * m). The terms present in the product are found by a second convolution of the
+// 'present' arrays, which counts the pairs of terms giving every exponent. The coefficients are computed in double precision and
+// rounded to float, so they can differ from the other methods in the last bits (errors below the precision of the transform are 0).
+Node *multiply_poly_dense(Node *p1, Node *p2)
+{
+    if (p1 == NULL || p2 == NULL)
+    {
+        return NULL;
+    }
+    // Products whose exponent rectangle is too large to store are computed with the hash table instead
+    if (!dense_fits(p1, p2))
+    {
+        return multiply_poly_hash(p1, p2);
+    }
+    DensePoly a = to_dense(p1), b = to_dense(p2);
+    DensePoly c;
+    c.i0 = a.i0 + b.i0;
+    c.j0 = a.j0 + b.j0;
+    c.rows = a.rows + b.rows - 1;
+    c.cols = a.cols + b.cols - 1;
+    long long size = (long long) c.rows * c.cols;
+    long long n = 2; // the FFT needs atleast 2 elements (for the roots of unity)
+    int levels = 1;
+    while (n < size)
+    {
+        n *= 2;
+        levels++;
+    }
+
+    Complex *roots = (Complex *) malloc(n * sizeof(Complex));
+    Complex *data = (Complex *) calloc(n, sizeof(Complex));
+    double *coef = (double *) malloc(n * sizeof(double));
+    double *count = (double *) malloc(n * sizeof(double));
+    c.coef = (float *) malloc(size * sizeof(float));
+    c.present = (unsigned char *) malloc(size * sizeof(unsigned char));
+    int ok = (a.coef != NULL && a.present != NULL && b.coef != NULL && b.present != NULL && roots != NULL && data != NULL
+              && coef != NULL && count != NULL && c.coef != NULL && c.present != NULL);
+    Node *result = NULL;
+    if (ok)
+    {
+        fft_roots(roots, (int) n);
+        ok = multiply_dense(&a, &b, &c, roots, (int) n, levels, data, coef, count);
+    }
+    if (ok)
+    {
+        result = from_dense(&c);
+    }
+
+    free(roots);
+    free(data);
+    free(coef);
+    free(count);
+    free(a.coef);
+    free(a.present);
+    free(b.coef);
+    free(b.present);
+    free(c.coef);
+    free(c.present);
+    // If there is not enough memory for the arrays, fall back to the hash table
+    return ok ? result : multiply_poly_hash(p1, p2);
 }
 
 // Function to multiply two polynomials stored as linked lists, and return the resulting polynomial
+// (dense polynomials are multiplied by FFT, others with a hash table)
 Node *multiply_poly(Node *p1, Node *p2)
 {
-    // The logic is to multiply each element of p2 with all elements of p1 to get partial products
-    // And then add up all the intermediate polynomials using the add function
+    if (use_dense(p1, p2))
+    {
+        return multiply_poly_dense(p1, p2);
+    }
+    return multiply_poly_hash(p1, p2);
+}
 
-    Node *result = NULL;
-    // result holds the final resulting polynomial whereas 
-    // 'partial' holds the intermediate partial products which have to be added up
+#define EVAL_BATCH 64 // number of points evaluated together by 'evaluate_points'
 
-    while (p2 != NULL)
+// Polynomial prepared for evaluation at many points: the distinct exponents of x and y, and for every term the positions of its
+// exponents among them, so that every power is computed once per point and looked up by the terms
+typedef struct Evaluator
+{
+    int terms; // number of terms
+    float *coef; // coefficient of every term
+    int *x_index, *y_index; // positions of the exponents of every term in 'x_exps' and 'y_exps'
+    int x_count, y_count; // number of distinct exponents of x and y
+    int *x_exps, *y_exps; // distinct exponents of x and y (in ascending order)
+} Evaluator;
+
+int compare_ints(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+// Function to sort 'values' and remove duplicates; returns the number of distinct values
+int sort_unique(int *values, int count)
+{
+    qsort(values, count, sizeof(int), compare_ints);
+    int distinct = 0;
+    for (int k = 0; k < count; k++)
     {
-        // Create a deep copy of polynomial p1 called 'partial' (to preserve the original polynomial p1)
-        // And multiply each term of partial (p1) with current term of p2 to compute the partial product
-        Node *partial = deep_copy_LL(p1);
-        Node *node = partial;
-        while (node != NULL)
+        if (distinct == 0 || values[distinct - 1] != values[k])
         {
-            // Perform multiplication on current pair of terms of polynomials partial(p1) and p2
-            node->i = node->i + p2->i;
-            node->j = node->j + p2->j;
-            node->p = node->p * p2->p;
+            values[distinct++] = values[k];
+        }
+    }
+    return distinct;
+}
 
-            node = node -> next;
+// Function to find the position of 'value' in the sorted array 'values' (which contains it)
+int find_int(int *values, int count, int value)
+{
+    int low = 0, high = count - 1;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (values[mid] < value)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
         }
+    }
+    return low;
+}
 
-        // Now 'partial' contains the partial product corresponding to one term of p2
-        // Add it to 'result'
-        result = add_poly(result, partial);
-        p2 = p2 -> next;
-        free_LL(partial); // Free the partial LL which is no longer required 
+// Function to prepare a polynomial (stored in arrays) for evaluation
+Evaluator new_evaluator(PolyArray *poly)
+{
+    Evaluator ev;
+    int n = poly->count;
+    ev.terms = n;
+    ev.coef = (float *) malloc((n > 0 ? n : 1) * sizeof(float));
+    ev.x_index = (int *) malloc((n > 0 ? n : 1) * sizeof(int));
+    ev.y_index = (int *) malloc((n > 0 ? n : 1) * sizeof(int));
+    ev.x_exps = (int *) malloc((n > 0 ? n : 1) * sizeof(int));
+    ev.y_exps = (int *) malloc((n > 0 ? n : 1) * sizeof(int));
+    for (int k = 0; k < n; k++)
+    {
+        ev.coef[k] = poly->coef[k];
+        ev.x_exps[k] = key_i(poly->key[k]);
+        ev.y_exps[k] = key_j(poly->key[k]);
+    }
+    ev.x_count = sort_unique(ev.x_exps, n);
+    ev.y_count = sort_unique(ev.y_exps, n);
+    for (int k = 0; k < n; k++)
+    {
+        ev.x_index[k] = find_int(ev.x_exps, ev.x_count, key_i(poly->key[k]));
+        ev.y_index[k] = find_int(ev.y_exps, ev.y_count, key_j(poly->key[k]));
     }
+    return ev;
+}
 
-    return result;
+void free_evaluator(Evaluator *ev)
+{
+    free(ev->coef);
+    free(ev->x_index);
+    free(ev->y_index);
+    free(ev->x_exps);
+    free(ev->y_exps);
+}
+
+// Function to compute x^e by repeated squaring (e may be negative)
+double int_power(double x, int e)
+{
+    unsigned long long k = (e < 0) ? -(long long) e : e;
+    double result = 1;
+    while (k > 0)
+    {
+        if (k & 1)
+        {
+            result *= x;
+        }
+        x *= x;
+        k >>= 1;
+    }
+    return (e < 0) ? 1 / result : result;
+}
+
+// Function to evaluate a polynomial at 'count' points (x[k], y[k]), storing the values in 'values'
+// Points are taken in batches of EVAL_BATCH: the powers of every distinct exponent are tabulated for the batch (one row per
+// exponent, one column per point), and then every term adds coef * x^i * y^j to all points of the batch. The loop over the points
+// of a batch reads contiguous rows and has a fixed length, so the compiler turns it into SIMD instructions; every term costs
+// 2 multiplications and an addition per point, while the powers are computed once per distinct exponent instead of once per term.
+// Terms are added in sorted order, so the values do not depend on how the points are batched.
+void evaluate_points(Evaluator *ev, const double *x, const double *y, double *values, int count)
+{
+    double *x_pow = (double *) malloc((size_t) (ev->x_count > 0 ? ev->x_count : 1) * EVAL_BATCH * sizeof(double));
+    double *y_pow = (double *) malloc((size_t) (ev->y_count > 0 ? ev->y_count : 1) * EVAL_BATCH * sizeof(double));
+    double sum[EVAL_BATCH];
+    for (int first = 0; first < count; first += EVAL_BATCH)
+    {
+        int size = (count - first < EVAL_BATCH) ? count - first : EVAL_BATCH;
+        // Tabulate the powers (the unused columns of the last batch are filled with powers of 1)
+        for (int e = 0; e < ev->x_count; e++)
+        {
+            for (int k = 0; k < EVAL_BATCH; k++)
+            {
+                x_pow[e * EVAL_BATCH + k] = int_power((k < size) ? x[first + k] : 1, ev->x_exps[e]);
+            }
+        }
+        for (int e = 0; e < ev->y_count; e++)
+        {
+            for (int k = 0; k < EVAL_BATCH; k++)
+            {
+                y_pow[e * EVAL_BATCH + k] = int_power((k < size) ? y[first + k] : 1, ev->y_exps[e]);
+            }
+        }
+
+        for (int k = 0; k < EVAL_BATCH; k++)
+        {
+            sum[k] = 0;
+        }
+        for (int t = 0; t < ev->terms; t++)
+        {
+            double coef = ev->coef[t];
+            const double *x_row = x_pow + (size_t) ev->x_index[t] * EVAL_BATCH;
+            const double *y_row = y_pow + (size_t) ev->y_index[t] * EVAL_BATCH;
+            for (int k = 0; k < EVAL_BATCH; k++)
+            {
+                sum[k] += coef * x_row[k] * y_row[k];
+            }
+        }
+        memcpy(values + first, sum, size * sizeof(double));
+    }
+    free(x_pow);
+    free(y_pow);
+}
+
+// Function to read a polynomial, and then a number of points n followed by n pairs "x y", and print the value at every point
+int run_eval()
+{
+    printf("Enter the polynomial in a single line (without spaces): ");
+    Node *poly = input();
+    int count;
+    printf("Enter the number of points followed by the points (x y): ");
+    if (scanf("%d", &count) != 1 || count < 0)
+    {
+        fprintf(stderr, "Invalid number of points\n");
+        return 1;
+    }
+    double *x = (double *) malloc((count > 0 ? count : 1) * sizeof(double));
+    double *y = (double *) malloc((count > 0 ? count : 1) * sizeof(double));
+    double *values = (double *) malloc((count > 0 ? count : 1) * sizeof(double));
+    for (int k = 0; k < count; k++)
+    {
+        if (scanf("%lf %lf", &x[k], &y[k]) != 2)
+        {
+            fprintf(stderr, "Invalid point %d\n", k + 1);
+            return 1;
+        }
+    }
+
+    PolyArray array = poly_to_array(poly);
+    Evaluator ev = new_evaluator(&array);
+    evaluate_points(&ev, x, y, values, count);
+    printf("\n");
+    for (int k = 0; k < count; k++)
+    {
+        printf("P(%g,%g) = %g\n", x[k], y[k], values[k]);
+    }
+
+    free_evaluator(&ev);
+    free_poly_array(&array);
+    free_LL(poly);
+    free(x);
+    free(y);
+    free(values);
+    return 0;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
     Node *poly1, *poly2, *result;
     char flag = 'y', op;
+
+    // --eval: evaluate a polynomial at a list of points
+    if (argc == 2 && strcmp(argv[1], "--eval") == 0)
+    {
+        return run_eval();
+    }
+
+    // Multiplication method: --method auto|naive|hash|heap|dense (by default, 'auto' uses 'dense' for dense polynomials and 'hash' for others),
+    // or --parallel N to multiply with N threads
+    char *method = "auto";
+    int threads = 0;
+    if (argc == 3 && strcmp(argv[1], "--method") == 0)
+    {
+        method = argv[2];
+        if (strcmp(method, "auto") != 0 && strcmp(method, "naive") != 0 && strcmp(method, "hash") != 0
+            && strcmp(method, "heap") != 0 && strcmp(method, "dense") != 0)
+        {
+            fprintf(stderr, "Unknown method %s, expected auto, naive, hash, heap or dense\n", method);
+            return 1;
+        }
+    }
+    else if (argc == 3 && strcmp(argv[1], "--parallel") == 0)
+    {
+        char *end;
+        long number = strtol(argv[2], &end, 10);
+        if (end == argv[2] || *end != 0 || number < 1 || number > MAX_THREADS)
+        {
+            fprintf(stderr, "Invalid number of threads %s, expected 1 to %d\n", argv[2], MAX_THREADS);
+            return 1;
+        }
+        threads = (int) number;
+    }
+    else if (argc != 1)
+    {
+        fprintf(stderr, "Usage: %s [--method auto|naive|hash|heap|dense | --parallel N | --eval]\n", argv[0]);
+        return 1;
+    }
     
     while (flag != 'n')
     {
@@ -331,7 +1538,30 @@ int main()
         }
         else 
         {
-            result = multiply_poly(poly1, poly2);
+            if (strcmp(method, "naive") == 0)
+            {
+                result = multiply_poly_naive(poly1, poly2);
+            }
+            else if (strcmp(method, "heap") == 0)
+            {
+                result = multiply_poly_heap(poly1, poly2);
+            }
+            else if (strcmp(method, "hash") == 0)
+            {
+                result = multiply_poly_hash(poly1, poly2);
+            }
+            else if (strcmp(method, "dense") == 0)
+            {
+                result = multiply_poly_dense(poly1, poly2);
+            }
+            else if (threads > 0)
+            {
+                result = multiply_poly_parallel(poly1, poly2, threads);
+            }
+            else
+            {
+                result = multiply_poly(poly1, poly2);
+            }
         }
 
         printf("\nA %c B: ", op);
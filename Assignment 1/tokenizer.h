@@ -0,0 +1,197 @@
+// Tokenizer shared by the programs of Assignment 1 (replace.c and poly.c) to parse their inputs.
+// It reads numbers directly from a buffer (a string read by scanf, or a whole file mapped into memory), without copying
+// them into temporary strings, never reads past the end of the buffer, and reports malformed input instead of guessing.
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct Tokenizer
+{
+    const char *text; // buffer being parsed (need not be NULL-terminated)
+    size_t length; // number of characters in 'text'
+    size_t pos; // index of the next character to be read
+    const char *error; // description of the first error found (NULL if there is none)
+    size_t error_pos; // index of the character where the error was found
+    int mapped; // 1 if 'text' is a file mapped by 'tokenizer_open_file'
+} Tokenizer;
+
+// Function to start parsing the first 'length' characters of 'text'
+static inline void tokenizer_init(Tokenizer *tok, const char *text, size_t length)
+{
+    tok -> text = text;
+    tok -> length = length;
+    tok -> pos = 0;
+    tok -> error = NULL;
+    tok -> error_pos = 0;
+    tok -> mapped = 0;
+}
+
+// Function to start parsing a whole file, which is mapped into memory instead of being read into a buffer.
+// Returns 0 if the file could not be opened
+static inline int tokenizer_open_file(Tokenizer *tok, const char *file_name)
+{
+    tokenizer_init(tok, "", 0);
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0)
+    {
+        close(fd);
+        return 0;
+    }
+    if (info.st_size > 0)
+    {
+        void *text = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text == MAP_FAILED)
+        {
+            close(fd);
+            return 0;
+        }
+        tokenizer_init(tok, (const char *) text, (size_t) info.st_size);
+        tok -> mapped = 1;
+    }
+    close(fd); // the mapping stays valid after the file is closed
+    return 1;
+}
+
+// Function to release the file mapped by 'tokenizer_open_file' (does nothing for a buffer given to 'tokenizer_init')
+static inline void tokenizer_close(Tokenizer *tok)
+{
+    if (tok -> mapped)
+    {
+        munmap((void *) tok -> text, tok -> length);
+    }
+    tokenizer_init(tok, "", 0);
+}
+
+// Function to record an error (only the first error is kept) and return 0, so that parse functions can 'return tokenizer_fail(...)'
+static inline int tokenizer_fail(Tokenizer *tok, const char *error)
+{
+    if (tok -> error == NULL)
+    {
+        tok -> error = error;
+        tok -> error_pos = tok -> pos;
+    }
+    return 0;
+}
+
+// Function to print the error of a tokenizer (if any) in the form "<what>: <error> at character <n>"
+static inline void tokenizer_report(Tokenizer *tok, const char *what, FILE *stream)
+{
+    if (tok -> error != NULL)
+    {
+        fprintf(stream, "%s: %s at character %zu\n", what, tok -> error, tok -> error_pos + 1);
+    }
+}
+
+// Function to skip whitespace and return the next character without consuming it (-1 at the end of the buffer)
+static inline int tokenizer_peek(Tokenizer *tok)
+{
+    while (tok -> pos < tok -> length && (tok -> text[tok -> pos] == ' ' || (tok -> text[tok -> pos] >= '\t' && tok -> text[tok -> pos] <= '\r')))
+    {
+        tok -> pos++;
+    }
+    return (tok -> pos < tok -> length) ? (unsigned char) tok -> text[tok -> pos] : -1;
+}
+
+// Function to consume the character 'c' (after skipping whitespace); returns 0 (and records an error) if the next character is different
+static inline int tokenizer_expect(Tokenizer *tok, char c)
+{
+    if (tokenizer_peek(tok) != (unsigned char) c)
+    {
+        return tokenizer_fail(tok, (tokenizer_peek(tok) == -1) ? "unexpected end of input" : "unexpected character");
+    }
+    tok -> pos++;
+    return 1;
+}
+
+// Function to parse an integer (an optional '-' followed by digits) into 'value'; returns 0 (and records an error) if there is none
+static inline int tokenizer_int(Tokenizer *tok, int *value)
+{
+    int negative = (tokenizer_peek(tok) == '-');
+    size_t pos = tok -> pos + negative;
+    size_t digits = pos;
+    // Leading zeros do not change the value, so they are skipped before counting digits towards the overflow limit
+    while (pos < tok -> length && tok -> text[pos] == '0')
+    {
+        pos++;
+    }
+    size_t begin = pos;
+    long long num = 0;
+    // Accumulate digits with a single (unsigned) comparison per character; 11 digits are enough to detect any overflow of 'int'
+    while (pos < tok -> length && pos - begin < 11)
+    {
+        unsigned digit = (unsigned) (tok -> text[pos] - '0');
+        if (digit > 9)
+        {
+            break;
+        }
+        num = num * 10 + digit;
+        pos++;
+    }
+    if (pos == digits)
+    {
+        return tokenizer_fail(tok, "expected an integer");
+    }
+    if (num > (long long) INT_MAX + negative || (pos < tok -> length && (unsigned) (tok -> text[pos] - '0') <= 9))
+    {
+        return tokenizer_fail(tok, "integer out of range");
+    }
+    *value = (int) (negative ? -num : num);
+    tok -> pos = pos;
+    return 1;
+}
+
+// Function to parse a decimal number (an optional '-', digits, and optionally '.' followed by digits) into 'value'
+// The number is converted by strtod (so it is rounded exactly like 'atof'), from a small copy on the stack
+static inline int tokenizer_float(Tokenizer *tok, float *value)
+{
+    tokenizer_peek(tok);
+    size_t pos = tok -> pos;
+    if (pos < tok -> length && tok -> text[pos] == '-')
+    {
+        pos++;
+    }
+    size_t digits = 0;
+    while (pos < tok -> length && (unsigned) (tok -> text[pos] - '0') <= 9)
+    {
+        pos++;
+        digits++;
+    }
+    if (pos < tok -> length && tok -> text[pos] == '.')
+    {
+        pos++;
+        while (pos < tok -> length && (unsigned) (tok -> text[pos] - '0') <= 9)
+        {
+            pos++;
+            digits++;
+        }
+    }
+    if (digits == 0)
+    {
+        return tokenizer_fail(tok, "expected a number");
+    }
+    char num[64];
+    if (pos - tok -> pos >= sizeof(num))
+    {
+        return tokenizer_fail(tok, "number too long");
+    }
+    memcpy(num, tok -> text + tok -> pos, pos - tok -> pos);
+    num[pos - tok -> pos] = 0;
+    *value = (float) strtod(num, NULL);
+    tok -> pos = pos;
+    return 1;
+}
+
+#endif
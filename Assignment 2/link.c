@@ -1,10 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define LL long long
 #define LLONG_MIN -9223372036854775807
 #define LLONG_MAX 9223372036854775807
 
+// 'ArenaBlock' is one large block of memory from which the nodes of a graph are carved out
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t used; // Number of bytes of 'data' already handed out
+    size_t size; // Capacity of 'data' in bytes
+    char data[];
+} ArenaBlock;
+
+// 'Arena' is a bump allocator: every allocation just advances a pointer, and all the blocks are released together with a single call
+typedef struct Arena
+{
+    ArenaBlock *head; // Block from which allocations are currently served
+} Arena;
+
 typedef struct ListNode
 {
     int vertex;
@@ -26,6 +42,8 @@ typedef struct Graph
     int numberOfVertices;
     int numberOfEdges;
     List *adjList;
+    Arena *arena; // Holds every List and ListNode of the graph
+    int *originalVertex; // originalVertex[v] is the vertex number of v in the input file, if the graph was reordered (NULL otherwise)
 } Graph;
 
 typedef struct Link
@@ -35,8 +53,35 @@ typedef struct Link
     double score;
 } Link;
 
-ListNode* createNewListNode(int vertex);
-List* createNewList(int vertex);
+// 'Shard' selects a slice of the source vertices to be scored by one worker process, so that the Top K links of a big graph can be computed by several processes
+typedef struct Shard
+{
+    int index; // Index of this shard, from 0 to count - 1
+    int count; // Total number of shards (0 means the whole graph is scored by this process)
+} Shard;
+
+// 'MinHashSketch' holds a MinHash signature for every vertex of a graph, so that Jaccard similarity can be estimated without enumerating neighborhoods
+typedef struct MinHashSketch
+{
+    int numberOfVertices;
+    int numberOfEdges; // Used to verify that a persisted sketch belongs to the same graph snapshot
+    int numberOfHashes; // Length of the signature of each vertex
+    unsigned long long fingerprint; // Hash of the edge list, so that a persisted sketch of an edited graph with the same size is not reused
+    unsigned int *signatures; // signatures[vertex * numberOfHashes + h] stores the minimum of hash function 'h' over the neighbors of 'vertex'
+} MinHashSketch;
+
+// 'BandEntry' is used for bucketing vertices by the hash of one band of their MinHash signature
+typedef struct BandEntry
+{
+    unsigned long long bandHash;
+    int vertex;
+} BandEntry;
+
+Arena* createNewArena();
+void* arenaAlloc(Arena *arena, size_t size);
+void deallocateArena(Arena *arena);
+ListNode* createNewListNode(Arena *arena, int vertex);
+List* createNewList(Arena *arena, int vertex);
 void insertAtEnd(List* list, ListNode *node);
 Graph inputGraph(char *fileName);
 void printAdjList(Graph G);
@@ -47,30 +92,158 @@ int lessThan(Link A, Link B);
 void adjustHeap(Link *heap, int K);
 void insertIntoHeap(Link *heap, int K, Link link);
 void displayHeap(Link *heap, int K, char *fileName, LL **convergenceIterations);
+int originalVertexOf(Graph G, int vertex);
+Link createLink(Graph G, int u, int v, double score);
+List** indexAdjLists(Graph G);
+int* computeComponents(Graph G);
+int compareIntegers(const void *A, const void *B);
+int compareRankedVertices(const void *A, const void *B);
+Graph reorderGraph(Graph G, char *method);
+void reportLocality(Graph G, char *label);
 double jaccardScore(List *listU, List *listV);
-void computeJaccard(Graph G, int K, char *fileName);
+int inShard(Shard shard, int vertex);
+void writePartialHeap(Link *heap, int K, char *fileName);
+int mergePartialHeaps(int numberOfFiles, char **partialFileNames, char *fileName);
+void computeJaccard(Graph G, int K, char *fileName, Shard shard);
 LL** computeAdjacencyMatrix(Graph G);
-LL** multiplyLLMatrices(LL **A, LL **B, Graph G);
-double** multiplyDoubleMatrices(double **A, double **B, Graph G);
-void deallocateLLMatrix(LL **matrix, int size);
-void deallocateDoubleMatrix(double **matrix, int size);
-void computeKatz(Graph G, int K, double constantBeta, char *fileName);
+LL** allocateLLMatrix(int size);
+double** allocateDoubleMatrix(int size);
+void multiplyLLMatrices(LL **A, LL **B, LL **C, Graph G, char *rows);
+void multiplyDoubleMatrices(double **A, double **B, double **C, Graph G, char *rows);
+void deallocateLLMatrix(LL **matrix);
+void deallocateDoubleMatrix(double **matrix);
+void computeKatz(Graph G, int K, double constantBeta, char *fileName, Shard shard);
 void computeCommuteTime1(Graph G, int K, char *fileName);
 double absolute(double N);
 void computeCommuteTime2(Graph G, int K, char *fileName);
+unsigned int minHash(unsigned int vertex, int hashIndex);
+unsigned long long edgeListFingerprint(Graph G);
+MinHashSketch* computeMinHashSketch(Graph G, int numberOfHashes);
+MinHashSketch* loadMinHashSketch(Graph G, int numberOfHashes, char *fileName);
+void saveMinHashSketch(MinHashSketch *sketch, char *fileName);
+void deallocateMinHashSketch(MinHashSketch *sketch);
+int isAdjacent(List *listU, int v);
+int compareBandEntries(const void *A, const void *B);
+int compareCandidates(const void *A, const void *B);
+int parsePositiveInteger(char *text, int *value);
+void computeJaccardMinHash(Graph G, int K, int numberOfHashes, int numberOfBands, char *sketchFileName, char *fileName);
+
+
+int main(int argc, char *argv[])
+{
+    char *graphFileName = "../contact-high-school-proj-graph.txt";
+    int useMinHash = 0; // If set, Jaccard scores are computed only for candidate links generated by MinHash sketches
+    int numberOfHashes = 128;
+    int numberOfBands = 64;
+    char *reorderMethod = NULL; // If set, the vertices are relabelled using this method before computing any scores
+    Shard shard = {0, 0};
+
+    // Parse the optional command line arguments
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--graph") == 0 && arg + 1 < argc)
+        {
+            graphFileName = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--minhash") == 0)
+        {
+            useMinHash = 1;
+        }
+        else if (strcmp(argv[arg], "--hashes") == 0 && arg + 1 < argc)
+        {
+            if (!parsePositiveInteger(argv[++arg], &numberOfHashes))
+            {
+                printf("Invalid number of hashes %s, expected a positive integer\n", argv[arg]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--bands") == 0 && arg + 1 < argc)
+        {
+            if (!parsePositiveInteger(argv[++arg], &numberOfBands))
+            {
+                printf("Invalid number of bands %s, expected a positive integer\n", argv[arg]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--reorder") == 0 && arg + 1 < argc)
+        {
+            reorderMethod = argv[++arg];
+            if (strcmp(reorderMethod, "degree") != 0 && strcmp(reorderMethod, "rcm") != 0 && strcmp(reorderMethod, "community") != 0)
+            {
+                printf("Invalid reorder method %s, expected degree, rcm or community\n", reorderMethod);
+                printf("Usage: %s [--graph file] [--minhash] [--hashes N] [--bands B] [--reorder degree|rcm|community] [--shard i/N]\n", argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--shard") == 0 && arg + 1 < argc)
+        {
+            // Score only the links whose source vertex belongs to shard i out of N, and write partial Top K files
+            if (sscanf(argv[++arg], "%d/%d", &shard.index, &shard.count) != 2 || shard.count < 1 || shard.index < 0 || shard.index >= shard.count)
+            {
+                printf("Invalid shard %s, expected i/N with 0 <= i < N\n", argv[arg]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--merge") == 0 && arg + 2 < argc)
+        {
+            // Merge the partial Top K files written by all the shards into the final output file: --merge output partial1 partial2 ...
+            return mergePartialHeaps(argc - arg - 2, argv + arg + 2, argv[arg + 1]);
+        }
+        else
+        {
+            printf("Unknown argument: %s\n", argv[arg]);
+            printf("Usage: %s [--graph file] [--minhash] [--hashes N] [--bands B] [--reorder degree|rcm|community] [--shard i/N]\n", argv[0]);
+            printf("       %s --merge output partial1 partial2 ...\n", argv[0]);
+            return 1;
+        }
+    }
 
+    if (shard.count > 0 && useMinHash)
+    {
+        // Shards score every non-existent link of their source vertices exactly; MinHash candidates are generated for the whole graph at once
+        printf("--minhash can not be combined with --shard\n");
+        return 1;
+    }
 
-int main()
-{
-    Graph G = inputGraph("../contact-high-school-proj-graph.txt");
+    Graph G = inputGraph(graphFileName);
     //printAdjList(G); // Uncomment to print the adjacency list of the Graph G
 
+    if (reorderMethod != NULL)
+    {
+        reportLocality(G, "input order");
+        G = reorderGraph(G, reorderMethod);
+        reportLocality(G, reorderMethod);
+    }
+
     int K;
     printf("\nEnter the value of K: ");
     scanf("%d", &K);
 
-    computeJaccard(G, K, "Jaccard.txt");
-    computeKatz(G, K, 0.1, "Katz.txt");
+    if (shard.count > 0)
+    {
+        // Each shard writes its partial Top K links in binary, which are combined later using --merge
+        char jaccardFileName[64], katzFileName[64];
+        sprintf(jaccardFileName, "Jaccard.shard-%d-of-%d.bin", shard.index, shard.count);
+        sprintf(katzFileName, "Katz.shard-%d-of-%d.bin", shard.index, shard.count);
+        computeJaccard(G, K, jaccardFileName, shard);
+        computeKatz(G, K, 0.1, katzFileName, shard);
+        deallocateGraph(G);
+        return 0;
+    }
+
+    if (useMinHash)
+    {
+        // The sketches are persisted next to the graph file, so that repeated runs skip sketch construction
+        char *sketchFileName = (char *) calloc(strlen(graphFileName) + 16, sizeof(char));
+        sprintf(sketchFileName, "%s.minhash", graphFileName);
+        computeJaccardMinHash(G, K, numberOfHashes, numberOfBands, sketchFileName, "Jaccard.txt");
+        free(sketchFileName);
+    }
+    else
+    {
+        computeJaccard(G, K, "Jaccard.txt", shard);
+    }
+    computeKatz(G, K, 0.1, "Katz.txt", shard);
     computeCommuteTime1(G, K, "HittingTime.txt");
     computeCommuteTime2(G, K, "HittingTimeAccurate.txt");
     deallocateGraph(G);
@@ -79,18 +252,62 @@ int main()
 }
 
 
+// Function to create a new empty arena
+Arena* createNewArena()
+{
+    Arena *arena = (Arena *) calloc(1, sizeof(Arena));
+    arena -> head = NULL;
+    return arena;
+}
+
+// Function to allocate 'size' bytes of zero-initialised memory from an arena in O(1) time
+// A new block (atleast 1 MB) is requested from the system only when the current block is full
+void* arenaAlloc(Arena *arena, size_t size)
+{
+    size = (size + 7) & ~((size_t) 7); // keep every allocation aligned to 8 bytes
+    if (arena -> head == NULL || arena -> head -> used + size > arena -> head -> size)
+    {
+        size_t blockSize = (size > (1 << 20)) ? size : (1 << 20);
+        ArenaBlock *block = (ArenaBlock *) calloc(1, sizeof(ArenaBlock) + blockSize);
+        block -> size = blockSize;
+        block -> used = 0;
+        block -> next = arena -> head;
+        arena -> head = block;
+    }
+    void *memory = arena -> head -> data + arena -> head -> used;
+    arena -> head -> used += size;
+    return memory;
+}
+
+// Function to deallocate an arena along with everything allocated from it
+void deallocateArena(Arena *arena)
+{
+    if (arena == NULL)
+    {
+        return;
+    }
+    ArenaBlock *block = arena -> head;
+    while (block != NULL)
+    {
+        ArenaBlock *nextBlock = block -> next;
+        free(block);
+        block = nextBlock;
+    }
+    free(arena);
+}
+
 // Function to create, initialise and return a new ListNode
-ListNode* createNewListNode(int vertex)
+ListNode* createNewListNode(Arena *arena, int vertex)
 {
-    ListNode *newNode = (ListNode *) calloc(1, sizeof(ListNode));
+    ListNode *newNode = (ListNode *) arenaAlloc(arena, sizeof(ListNode));
     newNode -> vertex = vertex;
     return newNode;
 }
 
 // Function to create, initialise and return a new Adjacency List
-List* createNewList(int vertex)
+List* createNewList(Arena *arena, int vertex)
 {
-    List *newList = (List *) calloc(1, sizeof(List));
+    List *newList = (List *) arenaAlloc(arena, sizeof(List));
     newList -> vertex = vertex;
     newList -> degree = 0;
     newList -> head = newList -> tail = NULL;
@@ -148,11 +365,13 @@ Graph inputGraph(char *fileName)
     G.numberOfVertices = numberOfVertices;
     G.numberOfEdges = numberOfEdges;
     G.adjList = NULL;
+    G.arena = createNewArena();
+    G.originalVertex = NULL;
     
     // Now compute the degree of each vertex and the adjacency list from the input file
     if (numberOfVertices > 0)
     {
-        G.adjList = createNewList(1); // since G has atleast 1 vertex
+        G.adjList = createNewList(G.arena, 1); // since G has atleast 1 vertex
     }
     else
     {
@@ -168,7 +387,7 @@ Graph inputGraph(char *fileName)
     {
         while (v > listV -> vertex)
         {
-            List *newList = createNewList(listV -> vertex + 1);
+            List *newList = createNewList(G.arena, listV -> vertex + 1);
             listV -> nextList = newList;
             listV = newList;
             listU = G.adjList; // Pointer to adjacency list of vertex 1 (reset listU)
@@ -180,8 +399,8 @@ Graph inputGraph(char *fileName)
         }
 
         // insert u in adjacency list of v (listV) and insert v in adjacency list of u (listU)
-        insertAtEnd(listU, createNewListNode(v));
-        insertAtEnd(listV, createNewListNode(u));
+        insertAtEnd(listU, createNewListNode(G.arena, v));
+        insertAtEnd(listV, createNewListNode(G.arena, u));
     }
 
     fclose(filePointer);
@@ -208,24 +427,313 @@ void printAdjList(Graph G)
 }
 
 // Function to deallocate the memory allocated to store the graph
+// (every List and ListNode lives in the graph's arena, so they are all released together)
 void deallocateGraph(Graph G)
 {
+    deallocateArena(G.arena);
+    free(G.originalVertex);
+}
+
+// Function to index the adjacency lists of G by vertex number, so that the adjacency list of any vertex can be accessed in O(1) time
+List** indexAdjLists(Graph G)
+{
+    List **vertexList = (List **) calloc(G.numberOfVertices + 1, sizeof(List *));
     List *adjList = G.adjList;
-    List *prevAdjList = NULL;
     while (adjList != NULL)
     {
-        ListNode *node = adjList -> head;
-        ListNode *prevNode = NULL;
-        while (node != NULL)
+        vertexList[adjList -> vertex] = adjList;
+        adjList = adjList -> nextList;
+    }
+    return vertexList;
+}
+
+// Function to label the connected components of G using BFS in O(V + E) time: component[u] == component[v] iff v can be reached from u
+int* computeComponents(Graph G)
+{
+    List **vertexList = indexAdjLists(G);
+    int *component = (int *) calloc(G.numberOfVertices + 1, sizeof(int)); // 0 means not visited yet
+    int *queue = (int *) calloc(G.numberOfVertices + 1, sizeof(int));
+    int numberOfComponents = 0;
+    for (int source = 1; source <= G.numberOfVertices; source++)
+    {
+        if (component[source] != 0)
         {
-            prevNode = node;
-            node = node -> next;
-            free(prevNode);
+            continue;
         }
-        prevAdjList = adjList;
-        adjList = adjList -> nextList;
-        free(prevAdjList);
+        numberOfComponents++;
+        component[source] = numberOfComponents;
+        int head = 0, tail = 0;
+        queue[tail++] = source;
+        while (head < tail)
+        {
+            ListNode *neighbor = vertexList[queue[head++]] -> head;
+            while (neighbor != NULL)
+            {
+                if (component[neighbor -> vertex] == 0)
+                {
+                    component[neighbor -> vertex] = numberOfComponents;
+                    queue[tail++] = neighbor -> vertex;
+                }
+                neighbor = neighbor -> next;
+            }
+        }
+    }
+    free(queue);
+    free(vertexList);
+    return component;
+}
+
+// Comparator for sorting integers in ascending order (used for sorting neighbors after relabelling)
+int compareIntegers(const void *A, const void *B)
+{
+    int a = *(const int *) A;
+    int b = *(const int *) B;
+    return (a > b) - (a < b);
+}
+
+// 'rankedVertices' is used by 'compareRankedVertices' to sort vertices by a precomputed key (qsort does not take a context argument)
+static LL *rankedVertices;
+
+// Comparator for sorting vertices in ascending order of rankedVertices[vertex], and then in ascending order of vertex number
+int compareRankedVertices(const void *A, const void *B)
+{
+    int a = *(const int *) A;
+    int b = *(const int *) B;
+    if (rankedVertices[a] != rankedVertices[b])
+    {
+        return (rankedVertices[a] < rankedVertices[b]) ? -1 : 1;
+    }
+    return a - b;
+}
+
+// Function to relabel the vertices of G, so that vertices accessed together get nearby vertex numbers and the neighbor accesses of the scoring kernels hit the cache more often.
+// 'method' is one of "degree" (descending degree), "rcm" (reverse Cuthill-McKee) or "community" (label propagation communities, kept contiguous).
+// The original graph is deallocated and the reordered graph is returned; 'originalVertex' of the new graph maps every vertex back to the input file.
+Graph reorderGraph(Graph G, char *method)
+{
+    int V = G.numberOfVertices;
+    List **vertexList = indexAdjLists(G);
+    int *order = (int *) calloc(V + 1, sizeof(int)); // order[k] is the old vertex which becomes vertex k + 1
+    rankedVertices = (LL *) calloc(V + 1, sizeof(LL));
+
+    if (strcmp(method, "rcm") == 0)
+    {
+        // Cuthill-McKee: BFS from a minimum degree vertex of every component, visiting neighbors in ascending order of degree. Then reverse the order.
+        char *visited = (char *) calloc(V + 1, sizeof(char));
+        int *neighbors = (int *) calloc(V + 1, sizeof(int));
+        int *byDegree = (int *) calloc(V + 1, sizeof(int));
+        for (int vertex = 1; vertex <= V; vertex++)
+        {
+            byDegree[vertex - 1] = vertex;
+            rankedVertices[vertex] = vertexList[vertex] -> degree;
+        }
+        qsort(byDegree, V, sizeof(int), compareRankedVertices);
+
+        int head = 0, tail = 0; // 'order' itself is used as the BFS queue
+        for (int k = 0; k < V; k++)
+        {
+            if (visited[byDegree[k]])
+            {
+                continue;
+            }
+            visited[byDegree[k]] = 1;
+            order[tail++] = byDegree[k];
+            while (head < tail)
+            {
+                int numberOfNeighbors = 0;
+                ListNode *neighbor = vertexList[order[head++]] -> head;
+                while (neighbor != NULL)
+                {
+                    if (!visited[neighbor -> vertex])
+                    {
+                        visited[neighbor -> vertex] = 1;
+                        neighbors[numberOfNeighbors++] = neighbor -> vertex;
+                    }
+                    neighbor = neighbor -> next;
+                }
+                qsort(neighbors, numberOfNeighbors, sizeof(int), compareRankedVertices);
+                for (int n = 0; n < numberOfNeighbors; n++)
+                {
+                    order[tail++] = neighbors[n];
+                }
+            }
+        }
+        for (int k = 0; k < V / 2; k++)
+        {
+            int temp = order[k];
+            order[k] = order[V - 1 - k];
+            order[V - 1 - k] = temp;
+        }
+        free(visited);
+        free(neighbors);
+        free(byDegree);
+    }
+    else if (strcmp(method, "community") == 0)
+    {
+        // Label propagation: every vertex repeatedly adopts the most frequent label among its neighbors (ties broken by the smallest label)
+        int *label = (int *) calloc(V + 1, sizeof(int));
+        int *labelCount = (int *) calloc(V + 1, sizeof(int));
+        int *touched = (int *) calloc(V + 1, sizeof(int));
+        for (int vertex = 1; vertex <= V; vertex++)
+        {
+            label[vertex] = vertex;
+        }
+        int changed = 1;
+        for (int pass = 0; pass < 20 && changed; pass++)
+        {
+            changed = 0;
+            for (int vertex = 1; vertex <= V; vertex++)
+            {
+                int numberOfTouched = 0;
+                int bestLabel = label[vertex], bestCount = 0;
+                ListNode *neighbor = vertexList[vertex] -> head;
+                while (neighbor != NULL)
+                {
+                    int l = label[neighbor -> vertex];
+                    if (labelCount[l] == 0)
+                    {
+                        touched[numberOfTouched++] = l;
+                    }
+                    labelCount[l]++;
+                    if (labelCount[l] > bestCount || (labelCount[l] == bestCount && l < bestLabel))
+                    {
+                        bestLabel = l;
+                        bestCount = labelCount[l];
+                    }
+                    neighbor = neighbor -> next;
+                }
+                for (int t = 0; t < numberOfTouched; t++)
+                {
+                    labelCount[touched[t]] = 0;
+                }
+                if (bestCount > 0 && bestLabel != label[vertex])
+                {
+                    label[vertex] = bestLabel;
+                    changed = 1;
+                }
+            }
+        }
+        // Keep every community contiguous, and order the vertices of a community by descending degree
+        for (int vertex = 1; vertex <= V; vertex++)
+        {
+            order[vertex - 1] = vertex;
+            rankedVertices[vertex] = (LL) label[vertex] * (V + 1) + (V - vertexList[vertex] -> degree);
+        }
+        qsort(order, V, sizeof(int), compareRankedVertices);
+        free(label);
+        free(labelCount);
+        free(touched);
+    }
+    else if (strcmp(method, "degree") == 0)
+    {
+        // Degree ordering: high degree vertices (hubs) which are accessed most often get the smallest vertex numbers
+        for (int vertex = 1; vertex <= V; vertex++)
+        {
+            order[vertex - 1] = vertex;
+            rankedVertices[vertex] = -vertexList[vertex] -> degree;
+        }
+        qsort(order, V, sizeof(int), compareRankedVertices);
+    }
+    else
+    {
+        // 'main' only accepts the methods above
+        printf("Unknown reorder method %s, expected degree, rcm or community\n", method);
+        exit(1);
+    }
+
+    int *newVertex = (int *) calloc(V + 1, sizeof(int)); // inverse permutation of 'order'
+    for (int k = 0; k < V; k++)
+    {
+        newVertex[order[k]] = k + 1;
+    }
+
+    // Build the reordered graph, keeping every adjacency list sorted by the new vertex numbers as assumed by the scoring functions
+    Graph R;
+    R.numberOfVertices = V;
+    R.numberOfEdges = G.numberOfEdges;
+    R.adjList = NULL;
+    R.arena = createNewArena();
+    R.originalVertex = (int *) calloc(V + 1, sizeof(int));
+    int *neighbors = (int *) calloc(V + 1, sizeof(int));
+    List *lastList = NULL;
+    for (int vertex = 1; vertex <= V; vertex++)
+    {
+        List *oldList = vertexList[order[vertex - 1]];
+        List *newList = createNewList(R.arena, vertex);
+        R.originalVertex[vertex] = originalVertexOf(G, oldList -> vertex);
+
+        int numberOfNeighbors = 0;
+        ListNode *neighbor = oldList -> head;
+        while (neighbor != NULL)
+        {
+            neighbors[numberOfNeighbors++] = newVertex[neighbor -> vertex];
+            neighbor = neighbor -> next;
+        }
+        qsort(neighbors, numberOfNeighbors, sizeof(int), compareIntegers);
+        for (int n = 0; n < numberOfNeighbors; n++)
+        {
+            insertAtEnd(newList, createNewListNode(R.arena, neighbors[n]));
+        }
+
+        if (lastList == NULL)
+        {
+            R.adjList = newList;
+        }
+        else
+        {
+            lastList -> nextList = newList;
+        }
+        lastList = newList;
+    }
+
+    free(neighbors);
+    free(newVertex);
+    free(order);
+    free(rankedVertices);
+    rankedVertices = NULL;
+    free(vertexList);
+    deallocateGraph(G);
+    return R;
+}
+
+// Function to print locality metrics of the current vertex numbering: bandwidth (maximum |u - v| over all edges),
+// average |u - v| over all edges, and the average log2 gap between consecutive neighbors in the adjacency lists
+void reportLocality(Graph G, char *label)
+{
+    LL bandwidth = 0, edges = 0;
+    double edgeSpan = 0, logGap = 0;
+    LL gaps = 0;
+    List *listU = G.adjList;
+    while (listU != NULL)
+    {
+        ListNode *neighborOfU = listU -> head;
+        int previous = -1;
+        while (neighborOfU != NULL)
+        {
+            LL span = (LL) listU -> vertex - neighborOfU -> vertex;
+            span = (span < 0) ? -span : span;
+            bandwidth = (span > bandwidth) ? span : bandwidth;
+            edgeSpan += span;
+            edges++;
+            if (previous != -1)
+            {
+                int gap = neighborOfU -> vertex - previous;
+                double bits = 0;
+                while (gap > 1)
+                {
+                    gap >>= 1;
+                    bits += 1;
+                }
+                logGap += bits;
+                gaps++;
+            }
+            previous = neighborOfU -> vertex;
+            neighborOfU = neighborOfU -> next;
+        }
+        listU = listU -> nextList;
     }
+    printf("Locality (%s): bandwidth %lld, average edge span %.2f, average log2 neighbor gap %.2f\n", label, bandwidth,
+           (edges > 0) ? edgeSpan / edges : 0.0, (gaps > 0) ? logGap / gaps : 0.0);
 }
 
 // Function to create a minHeap, which stores the top-K non-existent edges(links) ranked according to scores, 
@@ -395,6 +903,126 @@ void displayHeap(Link *heap, int K, char *fileName, LL **convergenceIterations)
     free(TopKLinks); 
 }
 
+// Function to return the vertex number of a vertex in the input file (undoes the permutation applied by 'reorderGraph')
+int originalVertexOf(Graph G, int vertex)
+{
+    if (G.originalVertex == NULL)
+    {
+        return vertex;
+    }
+    return G.originalVertex[vertex];
+}
+
+// Function to create a link between two vertices of G, where 'u' and 'v' are written using the vertex numbers of the input file (with u < v),
+// so that the heap ordering and the output files are the same irrespective of whether the graph was reordered
+Link createLink(Graph G, int u, int v, double score)
+{
+    Link link;
+    link.u = originalVertexOf(G, u);
+    link.v = originalVertexOf(G, v);
+    if (link.u > link.v)
+    {
+        int temp = link.u;
+        link.u = link.v;
+        link.v = temp;
+    }
+    link.score = score;
+    return link;
+}
+
+// Function to check whether links with the given source vertex are scored by this process
+int inShard(Shard shard, int vertex)
+{
+    // Vertices are assigned to shards round-robin, which balances the work since the number of candidate links of a vertex depends on its number
+    return (shard.count == 0 || vertex % shard.count == shard.index);
+}
+
+// Function to write the links stored in a heap to a partial Top K file in binary format:
+// "TOPKPART", K, number of links, followed by (u, v, score) of every link. Unused heap slots are not written.
+void writePartialHeap(Link *heap, int K, char *fileName)
+{
+    FILE *filePointer = fopen(fileName, "wb");
+    if (filePointer == NULL)
+    {
+        printf("Partial file %s could not be written.\n", fileName);
+        return;
+    }
+    int numberOfLinks = 0;
+    for (int i = 0; i < K; i++)
+    {
+        if (heap[i].score != LLONG_MIN)
+        {
+            numberOfLinks++;
+        }
+    }
+    int header[2] = {K, numberOfLinks};
+    fwrite("TOPKPART", sizeof(char), 8, filePointer);
+    fwrite(header, sizeof(int), 2, filePointer);
+    for (int i = 0; i < K; i++)
+    {
+        if (heap[i].score != LLONG_MIN)
+        {
+            fwrite(&heap[i].u, sizeof(int), 1, filePointer);
+            fwrite(&heap[i].v, sizeof(int), 1, filePointer);
+            fwrite(&heap[i].score, sizeof(double), 1, filePointer);
+        }
+    }
+    fclose(filePointer);
+}
+
+// Function to merge the partial Top K files written by all the shards, and write the final Top K links to the given file.
+// Since 'lessThan' is a total order on links, the merged output is identical to the output of a single process run. Returns 0 on success.
+int mergePartialHeaps(int numberOfFiles, char **partialFileNames, char *fileName)
+{
+    Link *heap = NULL;
+    int K = 0;
+    for (int file = 0; file < numberOfFiles; file++)
+    {
+        FILE *filePointer = fopen(partialFileNames[file], "rb");
+        char magic[8];
+        int header[2];
+        if (filePointer == NULL || fread(magic, sizeof(char), 8, filePointer) != 8 || memcmp(magic, "TOPKPART", 8) != 0 ||
+            fread(header, sizeof(int), 2, filePointer) != 2 || header[0] < 1 || (heap != NULL && header[0] != K))
+        {
+            printf("%s is not a valid partial Top K file (or was written with a different K).\n", partialFileNames[file]);
+            if (filePointer != NULL)
+            {
+                fclose(filePointer);
+            }
+            free(heap);
+            return 1;
+        }
+        if (heap == NULL)
+        {
+            K = header[0];
+            heap = (Link *) calloc(K, sizeof(Link));
+            for (int i = 0; i < K; i++)
+            {
+                heap[i].score = LLONG_MIN;
+            }
+        }
+        for (int i = 0; i < header[1]; i++)
+        {
+            Link link;
+            if (fread(&link.u, sizeof(int), 1, filePointer) != 1 || fread(&link.v, sizeof(int), 1, filePointer) != 1 ||
+                fread(&link.score, sizeof(double), 1, filePointer) != 1)
+            {
+                printf("%s is truncated.\n", partialFileNames[file]);
+                fclose(filePointer);
+                free(heap);
+                return 1;
+            }
+            insertIntoHeap(heap, K, link);
+        }
+        fclose(filePointer);
+    }
+
+    printf("Merged %d partial files into Top %d links written to %s\n", numberOfFiles, K, fileName);
+    displayHeap(heap, K, fileName, NULL);
+    free(heap);
+    return 0;
+}
+
 // compute jaccard coefficient of any two vertices given their adjacency lists, by computing the cardinality of their intersection and union
 double jaccardScore(List *listU, List *listV)
 {
@@ -429,7 +1057,8 @@ double jaccardScore(List *listU, List *listV)
 }
 
 // compute the Jaccard score for all non-existent edges (links) of the given graph using only the adjacency list, and write the Top K links output to the given file
-void computeJaccard(Graph G, int K, char *fileName)
+// If 'shard' is enabled, only the links (u, v) with v in the shard are scored, and a partial Top K file is written instead
+void computeJaccard(Graph G, int K, char *fileName, Shard shard)
 {
     Link link;
     Link *heap = createNewHeap(G, K);
@@ -440,6 +1069,11 @@ void computeJaccard(Graph G, int K, char *fileName)
     // Efficiently traverse all pairs of vertices and compute Jaccard score for non-adjacent edges
     while (listV != NULL)
     {
+        if (!inShard(shard, listV -> vertex))
+        {
+            listV = listV -> nextList;
+            continue;
+        }
         listU = G.adjList;
         ListNode *neighborOfV = listV -> head;
         while (neighborOfV != NULL && listU != NULL && listU -> vertex < listV -> vertex)
@@ -447,9 +1081,7 @@ void computeJaccard(Graph G, int K, char *fileName)
             if (listU -> vertex < neighborOfV -> vertex)
             {
                 // create a link and insert this link into the heap of top K links
-                link.u = listU -> vertex;
-                link.v = listV -> vertex;
-                link.score = jaccardScore(listU, listV);
+                link = createLink(G, listU -> vertex, listV -> vertex, jaccardScore(listU, listV));
                 insertIntoHeap(heap, K, link);
             }
             else
@@ -462,9 +1094,7 @@ void computeJaccard(Graph G, int K, char *fileName)
         while (listU != NULL && listU -> vertex <= G.numberOfVertices && listU -> vertex < listV -> vertex)
         {
             // create a link and insert this link into the heap of top K links
-            link.u = listU -> vertex;
-            link.v = listV -> vertex;
-            link.score = jaccardScore(listU, listV);
+            link = createLink(G, listU -> vertex, listV -> vertex, jaccardScore(listU, listV));
             insertIntoHeap(heap, K, link);
 
             listU = listU -> nextList;
@@ -473,8 +1103,16 @@ void computeJaccard(Graph G, int K, char *fileName)
         listV = listV -> nextList;
     }
     
-    printf("\nTop %d Jaccard Scores written to output file.\n", K);
-    displayHeap(heap, K, fileName, NULL);
+    if (shard.count > 0)
+    {
+        printf("\nPartial Top %d Jaccard Scores of shard %d/%d written to %s\n", K, shard.index, shard.count, fileName);
+        writePartialHeap(heap, K, fileName);
+    }
+    else
+    {
+        printf("\nTop %d Jaccard Scores written to output file.\n", K);
+        displayHeap(heap, K, fileName, NULL);
+    }
     free(heap); // free the dynamically allocated memory which is no longer required
 }
 
@@ -482,11 +1120,7 @@ void computeJaccard(Graph G, int K, char *fileName)
 LL** computeAdjacencyMatrix(Graph G)
 {
     // Dynamically allocate memory for adjacency matrix
-    LL **adjMatrix = (LL **) calloc(G.numberOfVertices + 1, sizeof(LL *));
-    for (LL vertex = 0; vertex <= G.numberOfVertices; vertex++)
-    {
-        adjMatrix[vertex] = (LL *) calloc(G.numberOfVertices + 1, sizeof(LL));
-    }
+    LL **adjMatrix = allocateLLMatrix(G.numberOfVertices);
 
     // Fill the adjacency matrix entries whose edges are present in graph
     List *listU = G.adjList;
@@ -507,82 +1141,108 @@ LL** computeAdjacencyMatrix(Graph G)
     return adjMatrix;
 }
 
-// Function to multiply two matrices of the datatype Long Long and return the resulting matrix
-LL** multiplyLLMatrices(LL **A, LL **B, Graph G)
+// Function to allocate a zero-initialised (size + 1) x (size + 1) matrix of datatype Long Long
+// The row pointers and all the rows live in a single allocation, so the whole matrix is released with a single free
+LL** allocateLLMatrix(int size)
 {
-    // Allocate space to store the resulting matrix
-    LL **C = (LL **) calloc(G.numberOfVertices + 1, sizeof(LL*));
-    for (int i = 0; i <= G.numberOfVertices + 1; i++)
+    size_t rowPointers = (size_t) (size + 1) * sizeof(LL *);
+    LL **matrix = (LL **) calloc(1, rowPointers + (size_t) (size + 1) * (size + 1) * sizeof(LL));
+    LL *rows = (LL *) ((char *) matrix + rowPointers);
+    for (int i = 0; i <= size; i++)
+    {
+        matrix[i] = rows + (size_t) i * (size + 1);
+    }
+    return matrix;
+}
+
+// Function to allocate a zero-initialised (size + 1) x (size + 1) matrix of datatype Double, in a single allocation
+double** allocateDoubleMatrix(int size)
+{
+    size_t rowPointers = (size_t) (size + 1) * sizeof(double *);
+    double **matrix = (double **) calloc(1, rowPointers + (size_t) (size + 1) * (size + 1) * sizeof(double));
+    double *rows = (double *) ((char *) matrix + rowPointers);
+    for (int i = 0; i <= size; i++)
     {
-        C[i] = (LL *) calloc(G.numberOfVertices + 1, sizeof(LL));
+        matrix[i] = rows + (size_t) i * (size + 1);
     }
+    return matrix;
+}
 
-    // Multiply matrices A and B, and store the result in matrix C
+// Function to multiply two matrices of the datatype Long Long and store the result in the preallocated matrix C (C must be different from A and B)
+// If 'rows' is not NULL, only the rows of C with rows[row] != 0 are computed (the other rows of C are left untouched)
+void multiplyLLMatrices(LL **A, LL **B, LL **C, Graph G, char *rows)
+{
+    // Multiply matrices A and B row by row, so that the rows of B and C are accessed sequentially
+    // Every C[row][col] still accumulates A[row][k] * B[k][col] in increasing order of k
     for (int row = 0; row <= G.numberOfVertices; row++)
     {
+        if (rows != NULL && !rows[row])
+        {
+            continue;
+        }
         for (int col = 0; col <= G.numberOfVertices; col++)
         {
-            // Multiply row of A and column of B, and store in C[row][col]
             C[row][col] = 0;
-            for (int k = 0; k <= G.numberOfVertices; k++)
+        }
+        for (int k = 0; k <= G.numberOfVertices; k++)
+        {
+            LL a = A[row][k];
+            if (a == 0)
+            {
+                continue; // adjacency and path matrices are sparse, so skip the rows of B which do not contribute
+            }
+            for (int col = 0; col <= G.numberOfVertices; col++)
             {
-                C[row][col] += A[row][k] * B[k][col];
+                C[row][col] += a * B[k][col];
             }
         }
     }
-
-    return C;
 }
 
-// Function to multiply two matrices of the datatype Long Long and return the resulting matrix
-double** multiplyDoubleMatrices(double **A, double **B, Graph G)
+// Function to multiply two matrices of the datatype Double and store the result in the preallocated matrix C (C must be different from A and B)
+// If 'rows' is not NULL, only the rows of C with rows[row] != 0 are computed (the other rows of C are left untouched)
+void multiplyDoubleMatrices(double **A, double **B, double **C, Graph G, char *rows)
 {
-    // Allocate space to store the resulting matrix
-    double **C = (double **) calloc(G.numberOfVertices + 1, sizeof(double*));
-    for (int i = 0; i <= G.numberOfVertices + 1; i++)
-    {
-        C[i] = (double *) calloc(G.numberOfVertices + 1, sizeof(double));
-    }
-
-    // Multiply matrices A and B, and store the result in matrix C
     for (int row = 0; row <= G.numberOfVertices; row++)
     {
+        if (rows != NULL && !rows[row])
+        {
+            continue;
+        }
         for (int col = 0; col <= G.numberOfVertices; col++)
         {
-            // Multiply row of A and column of B, and store in C[row][col]
             C[row][col] = 0;
-            for (int k = 0; k <= G.numberOfVertices; k++)
+        }
+        for (int k = 0; k <= G.numberOfVertices; k++)
+        {
+            double a = A[row][k];
+            if (a == 0)
+            {
+                continue;
+            }
+            for (int col = 0; col <= G.numberOfVertices; col++)
             {
-                C[row][col] += A[row][k] * B[k][col];
+                C[row][col] += a * B[k][col];
             }
         }
     }
-
-    return C;
 }
 
-// Function to deallocate a dynamically allocated matrix of datatype Long Long
-void deallocateLLMatrix(LL **matrix, int size)
+// Function to deallocate a matrix of datatype Long Long allocated by 'allocateLLMatrix'
+void deallocateLLMatrix(LL **matrix)
 {
-    for (int i = 0; i <= size; i++)
-    {
-        free(matrix[i]);
-    }
     free(matrix);
 }
 
-// Function to deallocate a dynamically allocated matrix of datatype Datatype
-void deallocateDoubleMatrix(double **matrix, int size)
+// Function to deallocate a matrix of datatype Double allocated by 'allocateDoubleMatrix'
+void deallocateDoubleMatrix(double **matrix)
 {
-    for (int i = 0; i <= size; i++)
-    {
-        free(matrix[i]);
-    }
     free(matrix);
 }
 
 // compute the Katz score for all non-existent edges (links) of the given graph, and write the Top K links output to the given file
-void computeKatz(Graph G, int K, double constantBeta, char *fileName)
+// If 'shard' is enabled, only the links (u, v) with u in the shard are scored (so only those rows of the path matrices are computed), and a partial Top K file is written instead
+void computeKatz(Graph G, int K, double constantBeta, char *fileName, Shard shard)
 {
     // First compute the adjacency matrix of G using the adjacency list, which will help us to count the number of paths of any length between vertices
     // Also, store the adjacency matrix as LL (long long) instead of int to prevent integer overflow in the future
@@ -591,30 +1251,42 @@ void computeKatz(Graph G, int K, double constantBeta, char *fileName)
     // Compute "paths" matrix, which will store the number of paths between any two vertices of a given "pathLength"
     // Also initialise "paths" matrix to the adjacency matrix and initially set corresponding "pathLength" as 1
     LL **paths = computeAdjacencyMatrix(G);
+    LL **nextPaths = allocateLLMatrix(G.numberOfVertices); // scratch buffer for the next power, swapped with 'paths' after every multiplication
     int pathLength = 1;
 
     // Also create a matrix called "katzScores" to score the katzScores of non-existent edges in the graph
-    double **katzScores = (double **) calloc(G.numberOfVertices + 1, sizeof(double *));
-    for (int vertex = 0; vertex <= G.numberOfVertices; vertex++)
-    {
-        katzScores[vertex] = (double *) calloc(G.numberOfVertices + 1, sizeof(double));
-    }
+    double **katzScores = allocateDoubleMatrix(G.numberOfVertices);
 
     Link *heap = createNewHeap(G, K);
 
+    char *shardRows = NULL; // rows of the path matrices required by this shard (NULL means all rows)
+    if (shard.count > 0)
+    {
+        shardRows = (char *) calloc(G.numberOfVertices + 1, sizeof(char));
+        for (int u = 1; u <= G.numberOfVertices; u++)
+        {
+            shardRows[u] = inShard(shard, u);
+        }
+    }
+
     // compute Katz score for non-existent edges, by summing up scores over path lengths 2 to 6
     double beta = constantBeta;
     for (pathLength = 2; pathLength <= 6; pathLength++)
     {
         // compute number of walks of pathLength 2 between all vertices
-        LL** previousPaths = paths; // 'previousPaths' is a temporary variable used to free this memory later
-        paths = multiplyLLMatrices(paths, adjMatrix, G);
-        deallocateLLMatrix(previousPaths, G.numberOfVertices);
+        multiplyLLMatrices(paths, adjMatrix, nextPaths, G, shardRows);
+        LL **temp = paths;
+        paths = nextPaths;
+        nextPaths = temp;
         beta *= constantBeta;
 
         // for every non-existent edge (u, v) compute katz score
         for (int u = 1; u <= G.numberOfVertices; u++)
         {
+            if (!inShard(shard, u))
+            {
+                continue;
+            }
             for (int v = u + 1; v <= G.numberOfVertices; v++)
             {
                 // check if non-existent edge
@@ -622,27 +1294,35 @@ void computeKatz(Graph G, int K, double constantBeta, char *fileName)
                 {
                     continue;
                 }
+                // Only katzScores[u][v] (u < v) is ever read, and paths is symmetric, so row v of paths is not needed here
                 katzScores[u][v] += beta * paths[u][v];
-                katzScores[v][u] += beta * paths[v][u];
                 
                 // insert link into heap along with it's katz score
                 if (pathLength == 6)
                 {
                     Link link;
-                    link.u = u;
-                    link.v = v;
-                    link.score = katzScores[u][v];
+                    link = createLink(G, u, v, katzScores[u][v]);
                     insertIntoHeap(heap, K, link);
                 }
             }
         }
     }
 
-    printf("\nTop %d Katz Scores written to output file.\n", K);
-    displayHeap(heap, K, fileName, NULL); // Display the top K links
-    deallocateLLMatrix(paths, G.numberOfVertices);
-    deallocateLLMatrix(adjMatrix, G.numberOfVertices);
-    deallocateDoubleMatrix(katzScores, G.numberOfVertices);
+    if (shard.count > 0)
+    {
+        printf("\nPartial Top %d Katz Scores of shard %d/%d written to %s\n", K, shard.index, shard.count, fileName);
+        writePartialHeap(heap, K, fileName);
+    }
+    else
+    {
+        printf("\nTop %d Katz Scores written to output file.\n", K);
+        displayHeap(heap, K, fileName, NULL); // Display the top K links
+    }
+    free(shardRows);
+    deallocateLLMatrix(paths);
+    deallocateLLMatrix(nextPaths);
+    deallocateLLMatrix(adjMatrix);
+    deallocateDoubleMatrix(katzScores);
     free(heap);
 }
 
@@ -652,13 +1332,9 @@ void computeCommuteTime1(Graph G, int K, char *fileName)
     LL **adjMatrix = computeAdjacencyMatrix(G);
     // 'transitionMatrix' is the probability transition matrix between vertices of the graph, whereas
     // 'pathMatrix' stores powers of the transition matrix, i.e, for every u,v pathMatrix[u][v] stores the probability of starting from vertex u and ending up in vertex v, after traversing a walk of length 'pathLength'
-    double **transitionMatrix = (double **) calloc(G.numberOfVertices + 1, sizeof(double *));
-    double **pathMatrix = (double **) calloc(G.numberOfVertices + 1, sizeof(double *));
-    for (int vertex = 0; vertex <= G.numberOfVertices; vertex++)
-    {
-        transitionMatrix[vertex] = (double *) calloc(G.numberOfVertices + 1, sizeof(double));
-        pathMatrix[vertex] = (double *) calloc(G.numberOfVertices + 1, sizeof(double));
-    }
+    double **transitionMatrix = allocateDoubleMatrix(G.numberOfVertices);
+    double **pathMatrix = allocateDoubleMatrix(G.numberOfVertices);
+    double **nextPathMatrix = allocateDoubleMatrix(G.numberOfVertices);
 
     // Compute the probability transition matrix using the adjacency matrix, and initialise pathMatrix = transitionMatrix for pathLength = 1
     int pathLength = 1;
@@ -682,19 +1358,17 @@ void computeCommuteTime1(Graph G, int K, char *fileName)
     free(adjacencySum);
 
     // create a matrix to store the commute time between every pair of vertices (for non-existent edges only)
-    double **commuteTime = (double **) calloc(G.numberOfVertices + 1, sizeof(double *));
-    for (int vertex = 0; vertex <= G.numberOfVertices; vertex++)
-    {
-        commuteTime[vertex] = (double *) calloc(G.numberOfVertices + 1, sizeof(double));
-    }
+    double **commuteTime = allocateDoubleMatrix(G.numberOfVertices);
     Link *heap = createNewHeap(G, K); // create new heap for storing the Top K links
 
     // compute commute time by taking summation from pathLength = 2 to 6 as mentioned in the question
     for (pathLength = 2; pathLength <= 6; pathLength++)
     {
-        double **previousPathMatrix = pathMatrix; // 'previousPathMatrix' is a temporary variable which helps to deallocate this memory later
-        pathMatrix = multiplyDoubleMatrices(pathMatrix, transitionMatrix, G);
-        deallocateDoubleMatrix(previousPathMatrix, G.numberOfVertices);
+        // 'nextPathMatrix' is a scratch buffer which is reused for every pathLength (double buffering), so nothing is allocated inside the loop
+        multiplyDoubleMatrices(pathMatrix, transitionMatrix, nextPathMatrix, G, NULL);
+        double **temp = pathMatrix;
+        pathMatrix = nextPathMatrix;
+        nextPathMatrix = temp;
 
         // for every u,v of non-existent edge, compute the commute time
         for (int u = 1; u <= G.numberOfVertices; u++)
@@ -714,9 +1388,7 @@ void computeCommuteTime1(Graph G, int K, char *fileName)
                 if (pathLength == 6)
                 {
                     Link link;
-                    link.u = u;
-                    link.v = v;
-                    link.score = commuteTime[u][v];
+                    link = createLink(G, u, v, commuteTime[u][v]);
                     insertIntoHeap(heap, K, link);
                 }
             }
@@ -725,10 +1397,11 @@ void computeCommuteTime1(Graph G, int K, char *fileName)
 
     printf("\nTop %d Commute Time Scores written to output file.\n", K);
     displayHeap(heap, K, fileName, NULL); // Display the top K links
-    deallocateLLMatrix(adjMatrix, G.numberOfVertices);
-    deallocateDoubleMatrix(commuteTime, G.numberOfVertices);
-    deallocateDoubleMatrix(pathMatrix, G.numberOfVertices);
-    deallocateDoubleMatrix(transitionMatrix, G.numberOfVertices);
+    deallocateLLMatrix(adjMatrix);
+    deallocateDoubleMatrix(commuteTime);
+    deallocateDoubleMatrix(pathMatrix);
+    deallocateDoubleMatrix(nextPathMatrix);
+    deallocateDoubleMatrix(transitionMatrix);
     free(heap);
 }
 
@@ -742,18 +1415,15 @@ double absolute(double N)
     return -N;
 }
 
-// compute the Commute Time score for all non-existent edges (links) of the given graph by taking summation till atleast K edges converge and reach the stopping condition given in question, and write the Top K links output to the given file (I did not wait for all edges(links) to converge since some links scores were actually diverging instead of converging)
+// compute the Commute Time score for all non-existent edges (links) of the given graph by taking summation till the Top K converged links can no longer change, and write the Top K links output to the given file
+// (I did not wait for all edges(links) to converge since some links scores were actually diverging instead of converging)
 void computeCommuteTime2(Graph G, int K, char *fileName)
 {
     LL **adjMatrix = computeAdjacencyMatrix(G);
     // Definition and use-case of transitionMatrix and pathMatrix same as in 'computeCommuteTime1' function, so not writing the same comments here
-    double **transitionMatrix = (double **) calloc(G.numberOfVertices + 1, sizeof(double *));
-    double **pathMatrix = (double **) calloc(G.numberOfVertices + 1, sizeof(double *));
-    for (int vertex = 0; vertex <= G.numberOfVertices; vertex++)
-    {
-        transitionMatrix[vertex] = (double *) calloc(G.numberOfVertices + 1, sizeof(double));
-        pathMatrix[vertex] = (double *) calloc(G.numberOfVertices + 1, sizeof(double));
-    }
+    double **transitionMatrix = allocateDoubleMatrix(G.numberOfVertices);
+    double **pathMatrix = allocateDoubleMatrix(G.numberOfVertices);
+    double **nextPathMatrix = allocateDoubleMatrix(G.numberOfVertices);
 
     // Initialise the probability transition matrix for path length = 1
     int pathLength = 1;
@@ -776,90 +1446,443 @@ void computeCommuteTime2(Graph G, int K, char *fileName)
     }
     free(adjacencySum);
 
-    double **commuteTime = (double **) calloc(G.numberOfVertices + 1, sizeof(double *));
-    for (int vertex = 0; vertex <= G.numberOfVertices; vertex++)
-    {
-        commuteTime[vertex] = (double *) calloc(G.numberOfVertices + 1, sizeof(double));
-    }
+    double **commuteTime = allocateDoubleMatrix(G.numberOfVertices);
     Link *heap = createNewHeap(G, K);
 
     int convergedEdges = 0; // Keeps track of the number of converged edges
-    // At the end of summing up commute times for each pathLength, we check whether atleast K edges have converged or not. If yes, we stop the loop.
 
     // used for storing 'x' (number of iterations needed for convergence) for HittingTimeAccurate
-    LL **convergence = (LL **) calloc(G.numberOfVertices + 1, sizeof(LL *));
-    for (int vertex = 0; vertex <= G.numberOfVertices; vertex++)
+    // A link (u, v) is 'active' while convergence[u][v] == 0. Once it converges, its score is frozen and it is never updated again.
+    LL **convergence = allocateLLMatrix(G.numberOfVertices);
+
+    // 'activeRows' marks the vertices which are part of atleast one active link. Only these rows of the next power of the transition matrix are required,
+    // since row u of pathMatrix for pathLength + 1 depends only on row u of pathMatrix for pathLength (and the set of active links only shrinks)
+    char *activeRows = (char *) calloc(G.numberOfVertices + 1, sizeof(char));
+    char *nextActiveRows = (char *) calloc(G.numberOfVertices + 1, sizeof(char));
+    for (int vertex = 1; vertex <= G.numberOfVertices; vertex++)
     {
-        convergence[vertex] = (LL *) calloc(G.numberOfVertices + 1, sizeof(LL));
+        activeRows[vertex] = 1;
     }
 
-    // I'm not considering summation of pathLengths more than 50, and I am stopping at this point since I don't want the program to fall into an infinite loop for wierd test cases
-    while (convergedEdges < K && pathLength <= 20) 
+    // Vertices in different connected components can never reach each other, so their commute time is infinite: the score of such a link stays 0,
+    // which would never pass the convergence test below and would keep the best active score at 0 forever. These links are never candidates.
+    int *component = computeComponents(G);
+
+    // Every term added to the commute time is negative, so the score of an active link can only decrease in future iterations.
+    // Hence once K links have converged, and the K-th best converged score beats the best active score, the Top K set can never change again and we stop.
+    int topKStable = 0;
+
+    // I'm not considering summation of pathLengths more than 21, and I am stopping at this point since I don't want the program to fall into an infinite loop for wierd test cases
+    while (!topKStable && pathLength <= 20)
     {
         pathLength++;
-        double **previousPathMatrix = pathMatrix;
-        pathMatrix = multiplyDoubleMatrices(pathMatrix, transitionMatrix, G);
-        deallocateDoubleMatrix(previousPathMatrix, G.numberOfVertices);
+        multiplyDoubleMatrices(pathMatrix, transitionMatrix, nextPathMatrix, G, activeRows);
+        double **temp = pathMatrix;
+        pathMatrix = nextPathMatrix;
+        nextPathMatrix = temp;
+
+        int activeLinks = 0;
+        double bestActiveScore = 0;
+        memset(nextActiveRows, 0, G.numberOfVertices + 1);
 
         for (int u = 1; u <= G.numberOfVertices; u++)
         {
+            if (!activeRows[u])
+            {
+                continue;
+            }
             for (int v = u + 1; v <= G.numberOfVertices; v++)
             {
-                // check if non-existent edge
-                if (adjMatrix[u][v] == 1)
+                // check if non-existent edge between reachable vertices, which has not converged yet
+                if (adjMatrix[u][v] == 1 || convergence[u][v] != 0 || component[u] != component[v])
                 {
                     continue;
                 }
 
-                double commuteTimeUV = commuteTime[u][v] - pathLength * (pathMatrix[u][v] + pathMatrix[v][u]);
+                double previousCommuteTimeUV = commuteTime[u][v];
+                double commuteTimeUV = previousCommuteTimeUV - pathLength * (pathMatrix[u][v] + pathMatrix[v][u]);
                 commuteTime[u][v] = commuteTimeUV;
                 commuteTime[v][u] = commuteTimeUV;
 
-                if (absolute(commuteTimeUV - commuteTime[u][v]) < 0.01 && absolute(commuteTimeUV) > 0.00001)
+                if (absolute(commuteTimeUV - previousCommuteTimeUV) < 0.01 && absolute(commuteTimeUV) > 0.00001)
                 {
+                    // Link converged, so freeze its score and record the number of iterations it needed
                     Link link;
-                    link.u = u;
-                    link.v = v;
-                    link.score = commuteTime[u][v];
+                    link = createLink(G, u, v, commuteTimeUV);
                     convergence[u][v] = pathLength;
                     convergence[v][u] = pathLength;
                     insertIntoHeap(heap, K, link);
                     convergedEdges++;
                 }
+                else
+                {
+                    if (activeLinks == 0 || commuteTimeUV > bestActiveScore)
+                    {
+                        bestActiveScore = commuteTimeUV;
+                    }
+                    activeLinks++;
+                    nextActiveRows[u] = 1;
+                    nextActiveRows[v] = 1;
+                }
             }
         }
+
+        char *tempRows = activeRows;
+        activeRows = nextActiveRows;
+        nextActiveRows = tempRows;
+
+        // heap[0] is the K-th best converged link once atleast K links have converged
+        if (activeLinks == 0 || (convergedEdges >= K && heap[0].score > bestActiveScore))
+        {
+            topKStable = 1;
+        }
     }
 
-    printf("\nNumber of links whose Commute Time Accurate scores actually converged according to the given stopping condition: %d\n", convergedEdges);
+    printf("\nNumber of links whose Commute Time Accurate scores actually converged according to the given stopping condition: %d (after summing upto pathLength %d)\n", convergedEdges, pathLength);
 
-    // cover the corner case of infinite loop
-    if (convergedEdges < K)
+    // cover the corner case where the iteration limit was reached before the Top K set became stable:
+    // the links which are still active compete with their current scores, and 'x' is written as -1 for them
+    if (!topKStable)
     {
         for (int u = 1; u <= G.numberOfVertices; u++)
         {
             for (int v = u + 1; v <= G.numberOfVertices; v++)
             {
-                if (adjMatrix[u][v] == 1)
+                if (adjMatrix[u][v] == 1 || convergence[u][v] != 0 || component[u] != component[v])
                 {
                     continue;
                 }
                 Link link;
-                link.u = u;
-                link.v = v;
-                link.score = commuteTime[u][v];
-                convergence[u][v] = -1; // -1 indicates this link hasn't actually converged yet
-                convergence[v][u] = -1;
+                link = createLink(G, u, v, commuteTime[u][v]);
                 insertIntoHeap(heap, K, link);
             }
         }
+        for (int u = 1; u <= G.numberOfVertices; u++)
+        {
+            for (int v = 1; v <= G.numberOfVertices; v++)
+            {
+                if (u != v && adjMatrix[u][v] == 0 && convergence[u][v] == 0)
+                {
+                    convergence[u][v] = -1; // -1 indicates this link hasn't actually converged yet
+                }
+            }
+        }
+    }
+
+    // 'displayHeap' looks up 'x' using the vertex numbers of the input file, so undo the reordering of the rows and columns of 'convergence'
+    if (G.originalVertex != NULL)
+    {
+        LL **originalConvergence = allocateLLMatrix(G.numberOfVertices);
+        for (int u = 1; u <= G.numberOfVertices; u++)
+        {
+            for (int v = 1; v <= G.numberOfVertices; v++)
+            {
+                originalConvergence[G.originalVertex[u]][G.originalVertex[v]] = convergence[u][v];
+            }
+        }
+        deallocateLLMatrix(convergence);
+        convergence = originalConvergence;
     }
+    free(activeRows);
+    free(nextActiveRows);
+    free(component);
 
     printf("Top %d Commute Time Accurate Scores written to output file.\n\n", K);
     displayHeap(heap, K, fileName, convergence); // Display the top K links
-    deallocateLLMatrix(adjMatrix, G.numberOfVertices);
-    deallocateLLMatrix(convergence, G.numberOfVertices);
-    deallocateDoubleMatrix(commuteTime, G.numberOfVertices);
-    deallocateDoubleMatrix(pathMatrix, G.numberOfVertices);
-    deallocateDoubleMatrix(transitionMatrix, G.numberOfVertices);
+    deallocateLLMatrix(adjMatrix);
+    deallocateLLMatrix(convergence);
+    deallocateDoubleMatrix(commuteTime);
+    deallocateDoubleMatrix(pathMatrix);
+    deallocateDoubleMatrix(nextPathMatrix);
+    deallocateDoubleMatrix(transitionMatrix);
+    free(heap);
+}
+
+// Hash function number 'hashIndex' of the MinHash family, applied on a vertex (a murmur3 style finaliser over a per-hash seed)
+unsigned int minHash(unsigned int vertex, int hashIndex)
+{
+    unsigned int h = vertex * 0x9E3779B1u ^ ((unsigned int) hashIndex * 0x85EBCA77u + 0x27D4EB2Fu);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// Function to compute a fingerprint of the edge list of a graph in O(V + E) time
+// Every edge is hashed using the vertex numbers of the input file and the hashes are added up, so the fingerprint does not depend on reordering
+unsigned long long edgeListFingerprint(Graph G)
+{
+    unsigned long long fingerprint = 0;
+    List *listU = G.adjList;
+    while (listU != NULL)
+    {
+        unsigned long long u = (unsigned int) originalVertexOf(G, listU -> vertex);
+        ListNode *neighborOfU = listU -> head;
+        while (neighborOfU != NULL)
+        {
+            unsigned long long h = (u << 32 | (unsigned int) originalVertexOf(G, neighborOfU -> vertex)) * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 29;
+            h *= 0xBF58476D1CE4E5B9ULL;
+            h ^= h >> 32;
+            fingerprint += h;
+            neighborOfU = neighborOfU -> next;
+        }
+        listU = listU -> nextList;
+    }
+    return fingerprint;
+}
+
+// Function to compute the MinHash signature of every vertex in a single pass over the adjacency list
+// Time complexity: O((V + E) * numberOfHashes)
+MinHashSketch* computeMinHashSketch(Graph G, int numberOfHashes)
+{
+    MinHashSketch *sketch = (MinHashSketch *) calloc(1, sizeof(MinHashSketch));
+    sketch -> numberOfVertices = G.numberOfVertices;
+    sketch -> numberOfEdges = G.numberOfEdges;
+    sketch -> numberOfHashes = numberOfHashes;
+    sketch -> fingerprint = edgeListFingerprint(G);
+    sketch -> signatures = (unsigned int *) malloc((size_t) (G.numberOfVertices + 1) * numberOfHashes * sizeof(unsigned int));
+    for (size_t index = 0; index < (size_t) (G.numberOfVertices + 1) * numberOfHashes; index++)
+    {
+        sketch -> signatures[index] = 0xFFFFFFFFu; // maximum value of unsigned int
+    }
+
+    List *listU = G.adjList;
+    while (listU != NULL)
+    {
+        // Signatures are stored and hashed using the vertex numbers of the input file, so that a persisted sketch stays valid after reordering
+        unsigned int *signature = sketch -> signatures + (size_t) originalVertexOf(G, listU -> vertex) * numberOfHashes;
+        ListNode *neighborOfU = listU -> head;
+        while (neighborOfU != NULL)
+        {
+            unsigned int neighbor = originalVertexOf(G, neighborOfU -> vertex);
+            for (int h = 0; h < numberOfHashes; h++)
+            {
+                unsigned int value = minHash(neighbor, h);
+                if (value < signature[h])
+                {
+                    signature[h] = value;
+                }
+            }
+            neighborOfU = neighborOfU -> next;
+        }
+        listU = listU -> nextList;
+    }
+    return sketch;
+}
+
+// Function to load a persisted MinHash sketch, returns NULL if the file does not exist or belongs to a different graph (size or edge list) / sketch size
+MinHashSketch* loadMinHashSketch(Graph G, int numberOfHashes, char *fileName)
+{
+    FILE *filePointer = fopen(fileName, "rb");
+    if (filePointer == NULL)
+    {
+        return NULL;
+    }
+
+    char magic[8];
+    int header[3];
+    unsigned long long fingerprint;
+    if (fread(magic, sizeof(char), 8, filePointer) != 8 || memcmp(magic, "MINHASH2", 8) != 0 ||
+        fread(header, sizeof(int), 3, filePointer) != 3 || fread(&fingerprint, sizeof(fingerprint), 1, filePointer) != 1 ||
+        header[0] != G.numberOfVertices || header[1] != G.numberOfEdges || header[2] != numberOfHashes ||
+        fingerprint != edgeListFingerprint(G))
+    {
+        fclose(filePointer);
+        return NULL;
+    }
+
+    MinHashSketch *sketch = (MinHashSketch *) calloc(1, sizeof(MinHashSketch));
+    sketch -> numberOfVertices = G.numberOfVertices;
+    sketch -> numberOfEdges = G.numberOfEdges;
+    sketch -> numberOfHashes = numberOfHashes;
+    sketch -> fingerprint = fingerprint;
+    size_t count = (size_t) (G.numberOfVertices + 1) * numberOfHashes;
+    sketch -> signatures = (unsigned int *) malloc(count * sizeof(unsigned int));
+    if (fread(sketch -> signatures, sizeof(unsigned int), count, filePointer) != count)
+    {
+        // truncated file, so the sketch has to be rebuilt
+        deallocateMinHashSketch(sketch);
+        sketch = NULL;
+    }
+    fclose(filePointer);
+    return sketch;
+}
+
+// Function to persist a MinHash sketch to a binary file, so that repeated runs on the same graph skip sketch construction
+void saveMinHashSketch(MinHashSketch *sketch, char *fileName)
+{
+    FILE *filePointer = fopen(fileName, "wb");
+    if (filePointer == NULL)
+    {
+        printf("Sketch file %s could not be written.\n", fileName);
+        return;
+    }
+    int header[3] = {sketch -> numberOfVertices, sketch -> numberOfEdges, sketch -> numberOfHashes};
+    fwrite("MINHASH2", sizeof(char), 8, filePointer);
+    fwrite(header, sizeof(int), 3, filePointer);
+    fwrite(&sketch -> fingerprint, sizeof(sketch -> fingerprint), 1, filePointer);
+    fwrite(sketch -> signatures, sizeof(unsigned int), (size_t) (sketch -> numberOfVertices + 1) * sketch -> numberOfHashes, filePointer);
+    fclose(filePointer);
+}
+
+// Function to deallocate the memory allocated to store a MinHash sketch
+void deallocateMinHashSketch(MinHashSketch *sketch)
+{
+    free(sketch -> signatures);
+    free(sketch);
+}
+
+// Function to check whether vertex v is present in the (sorted) adjacency list of vertex u
+int isAdjacent(List *listU, int v)
+{
+    ListNode *neighborOfU = listU -> head;
+    while (neighborOfU != NULL && neighborOfU -> vertex < v)
+    {
+        neighborOfU = neighborOfU -> next;
+    }
+    return (neighborOfU != NULL && neighborOfU -> vertex == v);
+}
+
+// Comparator for sorting band entries by band hash (and then by vertex, so that the buckets are deterministic)
+int compareBandEntries(const void *A, const void *B)
+{
+    const BandEntry *a = (const BandEntry *) A;
+    const BandEntry *b = (const BandEntry *) B;
+    if (a -> bandHash != b -> bandHash)
+    {
+        return (a -> bandHash < b -> bandHash) ? -1 : 1;
+    }
+    return a -> vertex - b -> vertex;
+}
+
+// Comparator for sorting candidate links encoded as u * (V + 1) + v
+int compareCandidates(const void *A, const void *B)
+{
+    LL a = *(const LL *) A;
+    LL b = *(const LL *) B;
+    return (a > b) - (a < b);
+}
+
+// Function to parse a positive integer command line argument, returns 0 if 'text' is not a positive integer that fits in an int
+int parsePositiveInteger(char *text, int *value)
+{
+    char *end;
+    long number = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || number < 1 || (long) (int) number != number)
+    {
+        return 0;
+    }
+    *value = (int) number;
+    return 1;
+}
+
+// compute the Jaccard score only for the non-existent edges (links) whose vertices collide in atleast one LSH band of their MinHash signatures,
+// and write the Top K links output to the given file. The candidates are rescored exactly using 'jaccardScore', so only recall is approximate.
+void computeJaccardMinHash(Graph G, int K, int numberOfHashes, int numberOfBands, char *sketchFileName, char *fileName)
+{
+    if (numberOfBands > numberOfHashes)
+    {
+        numberOfBands = numberOfHashes;
+    }
+    int rowsPerBand = numberOfHashes / numberOfBands;
+
+    // Reuse the persisted sketch of this graph snapshot if possible, otherwise build it in one pass and persist it
+    MinHashSketch *sketch = loadMinHashSketch(G, numberOfHashes, sketchFileName);
+    if (sketch == NULL)
+    {
+        sketch = computeMinHashSketch(G, numberOfHashes);
+        saveMinHashSketch(sketch, sketchFileName);
+    }
+    else
+    {
+        printf("\nMinHash sketch loaded from %s\n", sketchFileName);
+    }
+
+    // Index the adjacency lists by vertex number, so that candidate pairs can be rescored in O(1) lookup time
+    List **vertexList = indexAdjLists(G);
+
+    BandEntry *entries = (BandEntry *) calloc(G.numberOfVertices + 1, sizeof(BandEntry));
+    LL candidateCapacity = 1024, numberOfCandidates = 0;
+    LL *candidates = (LL *) malloc(candidateCapacity * sizeof(LL));
+
+    // For every band, bucket the vertices by the hash of that band, and every pair of vertices in the same bucket becomes a candidate link
+    for (int band = 0; band < numberOfBands; band++)
+    {
+        int numberOfEntries = 0;
+        for (int vertex = 1; vertex <= G.numberOfVertices; vertex++)
+        {
+            if (vertexList[vertex] == NULL || vertexList[vertex] -> degree == 0)
+            {
+                continue; // Isolated vertices have no neighbors to be similar on
+            }
+            unsigned int *signature = sketch -> signatures + (size_t) originalVertexOf(G, vertex) * numberOfHashes + band * rowsPerBand;
+            unsigned long long bandHash = 1469598103934665603ULL;
+            for (int row = 0; row < rowsPerBand; row++)
+            {
+                bandHash = (bandHash ^ signature[row]) * 1099511628211ULL;
+            }
+            entries[numberOfEntries].bandHash = bandHash;
+            entries[numberOfEntries].vertex = vertex;
+            numberOfEntries++;
+        }
+        qsort(entries, numberOfEntries, sizeof(BandEntry), compareBandEntries);
+
+        int start = 0;
+        while (start < numberOfEntries)
+        {
+            int end = start + 1;
+            while (end < numberOfEntries && entries[end].bandHash == entries[start].bandHash)
+            {
+                end++;
+            }
+            for (int a = start; a < end; a++)
+            {
+                for (int b = a + 1; b < end; b++)
+                {
+                    if (numberOfCandidates == candidateCapacity)
+                    {
+                        candidateCapacity *= 2;
+                        candidates = (LL *) realloc(candidates, candidateCapacity * sizeof(LL));
+                    }
+                    // entries are sorted by vertex within a bucket, so entries[a].vertex < entries[b].vertex
+                    candidates[numberOfCandidates++] = (LL) entries[a].vertex * (G.numberOfVertices + 1) + entries[b].vertex;
+                }
+            }
+            start = end;
+        }
+    }
+
+    // Remove duplicate candidates (pairs colliding in several bands), then rescore the non-existent edges exactly
+    qsort(candidates, numberOfCandidates, sizeof(LL), compareCandidates);
+    Link *heap = createNewHeap(G, K);
+    int numberOfRescoredLinks = 0;
+    for (LL index = 0; index < numberOfCandidates; index++)
+    {
+        if (index > 0 && candidates[index] == candidates[index - 1])
+        {
+            continue;
+        }
+        int u = (int) (candidates[index] / (G.numberOfVertices + 1));
+        int v = (int) (candidates[index] % (G.numberOfVertices + 1));
+        if (isAdjacent(vertexList[u], v))
+        {
+            continue;
+        }
+        Link link;
+        link = createLink(G, u, v, jaccardScore(vertexList[u], vertexList[v]));
+        insertIntoHeap(heap, K, link);
+        numberOfRescoredLinks++;
+    }
+
+    printf("\nMinHash candidates rescored: %d\n", numberOfRescoredLinks);
+    printf("Top %d Jaccard Scores (MinHash candidates) written to output file.\n", K);
+    displayHeap(heap, K, fileName, NULL);
     free(heap);
-}
\ No newline at end of file
+    free(candidates);
+    free(entries);
+    free(vertexList);
+    deallocateMinHashSketch(sketch);
+}